@@ -0,0 +1,139 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+
+/* Default Tensor allocator: every buffer starts on a cache line, so packets never straddle two lines */
+template <typename T, size_t Align = 64>
+struct AlignedAllocator {
+    static_assert(Align >= alignof(T) && (Align & (Align - 1)) == 0);
+
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Align>;
+    };
+
+
+    constexpr AlignedAllocator() noexcept = default;
+
+    template <typename U>
+    constexpr AlignedAllocator(const AlignedAllocator<U, Align>&) noexcept {}
+
+    [[nodiscard]] T* allocate(size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{Align}));
+    }
+
+    void deallocate(T* ptr, size_t) noexcept {
+        ::operator delete(ptr, std::align_val_t{Align});
+    }
+
+    template <typename U>
+    friend constexpr bool operator==(const AlignedAllocator&, const AlignedAllocator<U, Align>&) noexcept {
+        return true;
+    }
+};
+
+
+/* Bump allocator for short-lived temporaries: allocations are only released all at once by reset().
+ * Blocks are kept across resets, so a steady-state loop stops touching the system allocator.
+ * Not thread-safe; give each thread its own arena. */
+class Arena {
+public:
+    explicit Arena(size_t block_size = size_t{1} << 20) : block_size(block_size) {}
+
+    Arena(const Arena&) = delete;
+
+    Arena& operator=(const Arena&) = delete;
+
+    [[nodiscard]] void* allocate(size_t bytes, size_t align) {
+        while (current < blocks.size()) {
+            auto& block = blocks[current];
+            /* Aligns the address rather than the offset, since a block is only aligned as far as it was asked to be */
+            const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+            const size_t start = ((base + offset + align - 1) & ~(align - 1)) - base;
+            if (start + bytes <= block.size) {
+                offset = start + bytes;
+                return block.data.get() + start;
+            }
+            ++current;
+            offset = 0;
+        }
+        const size_t size = std::max(block_size, bytes + align);
+        const size_t alignment = std::max(block_align, align);
+        auto* data = static_cast<std::byte*>(::operator new(size, std::align_val_t{alignment}));
+        blocks.push_back({std::unique_ptr<std::byte[], AlignedDelete>(data, AlignedDelete{alignment}), size});
+        current = blocks.size() - 1;
+        offset = 0;
+        return allocate(bytes, align);
+    }
+
+    void reset() noexcept {
+        current = 0;
+        offset = 0;
+    }
+
+private:
+    static constexpr size_t block_align = 64;
+
+    struct AlignedDelete {
+        size_t alignment = block_align;
+
+        void operator()(std::byte* ptr) const noexcept {
+            ::operator delete(ptr, std::align_val_t{alignment});
+        }
+    };
+
+    struct Block {
+        std::unique_ptr<std::byte[], AlignedDelete> data;
+        size_t size;
+    };
+
+    size_t block_size;
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+};
+
+
+template <typename T, size_t Align = 64>
+struct ArenaAllocator {
+    static_assert(Align >= alignof(T) && (Align & (Align - 1)) == 0);
+
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = ArenaAllocator<U, Align>;
+    };
+
+
+    constexpr ArenaAllocator(Arena& arena) noexcept : arena(&arena) {}
+
+    template <typename U>
+    constexpr ArenaAllocator(const ArenaAllocator<U, Align>& other) noexcept : arena(other.arena) {}
+
+    [[nodiscard]] T* allocate(size_t count) {
+        return static_cast<T*>(arena->allocate(count * sizeof(T), Align));
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    template <typename U>
+    friend constexpr bool operator==(const ArenaAllocator& lhs, const ArenaAllocator<U, Align>& rhs) noexcept {
+        return lhs.arena == rhs.arena;
+    }
+
+private:
+    template <typename U, size_t A>
+    friend struct ArenaAllocator;
+
+    Arena* arena;
+};
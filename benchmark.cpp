@@ -0,0 +1,505 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <valarray>
+#include <vector>
+
+#include "compress.h"
+#include "mask.h"
+#include "scan.h"
+#include "tensor.h"
+
+
+/* Throughput of every element-wise operator, and of expressions 1 to 10 multiply-adds deep, for three
+ * implementations: the expression templates ("tensor"), a hand-written loop over raw pointers ("loop") and
+ * std::valarray ("valarray"). Sizes default to one working set per cache level, from L1 to well past the LLC.
+ *
+ * Output is CSV on stdout, one row per measurement:
+ *     impl,op,type,elements,depth,ns_per_element,elements_per_second,gigabytes_per_second
+ * where bytes count every operand read once and the result written once.
+ *
+ * Usage: benchmark [--filter SUBSTRING] [--sizes N,N,...] [--min-time SECONDS] [--threads N]
+ * Build with the flags the library will ship with (e.g. -march=native); SIMD width is fixed at compile time. */
+
+
+namespace {
+    struct Options {
+        std::string filter;
+        std::vector<size_t> sizes{size_t{1} << 10, size_t{1} << 15, size_t{1} << 20, size_t{1} << 22};
+        double min_time = 0.05;
+        size_t threads = 1;
+    };
+
+    template <typename T>
+    constexpr std::string_view type_name() {
+        if constexpr (std::is_same_v<T, float>) {
+            return "float32";
+        } else if constexpr (std::is_same_v<T, double>) {
+            return "float64";
+        } else if constexpr (detail::half_floating<T>) {
+            return detail::type_name<T>();
+        } else {
+            static_assert(std::is_same_v<T, int32_t>);
+            return "int32";
+        }
+    }
+
+    /* Four operands per type and size, identical in all three representations. Floating operands 0 and 2 lie in
+     * [0.1, 0.9) and 1 and 3 in [1.1, 4), so every op below has a valid domain; integers lie in [1, 1000). */
+    template <typename T>
+    struct Operands {
+        explicit Operands(size_t n) {
+            std::mt19937_64 rng(n);
+            for (size_t k = 0; k < 4; ++k) {
+                Tensor<T> t(Shape{n});
+                for (size_t i = 0; i < n; ++i) {
+                    if constexpr (!std::is_integral_v<T>) {
+                        using F = detail::compute_type<T>;
+                        t.data()[i] = k % 2 == 0 ? std::uniform_real_distribution<F>(0.1, 0.9)(rng)
+                                                 : std::uniform_real_distribution<F>(1.1, 4)(rng);
+                    } else {
+                        t.data()[i] = std::uniform_int_distribution<T>(1, 999)(rng);
+                    }
+                }
+                arrays.emplace_back(t.data(), n);
+                pointers[k] = t.data();
+                tensors.push_back(std::move(t));
+            }
+        }
+
+        [[nodiscard]] size_t size() const {
+            return tensors[0].size();
+        }
+
+        std::vector<Tensor<T>> tensors;
+        std::vector<std::valarray<T>> arrays;
+        std::array<const T*, 4> pointers{};
+    };
+
+    volatile double sink;
+
+    /* Seconds per run of f: one warm-up run, then doubling repetitions until min_time is covered */
+    template <typename F>
+    double seconds_per_run(const Options& options, F&& f) {
+        using clock = std::chrono::steady_clock;
+        f();
+        for (size_t reps = 1;; reps *= 2) {
+            const auto start = clock::now();
+            for (size_t r = 0; r < reps; ++r) {
+                f();
+            }
+            const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            if (elapsed >= options.min_time) {
+                return elapsed / static_cast<double>(reps);
+            }
+        }
+    }
+
+    void report(std::string_view impl, std::string_view op, std::string_view type, size_t n, size_t depth,
+                double seconds, double bytes_per_element) {
+        const double elements = static_cast<double>(n);
+        std::printf("%.*s,%.*s,%.*s,%zu,%zu,%.4f,%.6g,%.4f\n", int(impl.size()), impl.data(), int(op.size()), op.data(),
+                    int(type.size()), type.data(), n, depth, seconds * 1e9 / elements, elements / seconds,
+                    elements * bytes_per_element / seconds * 1e-9);
+    }
+
+    /* Times one op in each implementation that is given; pass nullptr for a missing loop or valarray form.
+     * expr maps the operand tensors to an expression, loop maps (operand pointers, index) to one element, and
+     * array assigns into its first argument a valarray expression of the operands (it cannot return one, since
+     * nested valarray expressions refer to temporaries). reads is how many distinct operands are used. */
+    template <typename T, typename Expr, typename Loop, typename Array>
+    void compare(const Options& options, std::string_view op, size_t depth, const Operands<T>& in, size_t reads,
+                 Expr expr, Loop loop, Array array) {
+        if (op.find(options.filter) == std::string_view::npos) {
+            return;
+        }
+        /* Arithmetic on 16-bit floats gives float; store it back in 16 bits, as an embedding update would */
+        using E = typename decltype(expr(in.tensors))::element_type;
+        using R = std::conditional_t<detail::half_floating<T> && std::is_same_v<E, float>, T, E>;
+        const size_t n = in.size();
+        const size_t bytes = reads * sizeof(T) + sizeof(R);
+        {
+            Tensor<R> out(Shape{n});
+            const double seconds = seconds_per_run(options, [&] { out = expr(in.tensors); });
+            sink = static_cast<double>(out.data()[n / 2]);
+            report("tensor", op, type_name<T>(), n, depth, seconds, bytes);
+        }
+        if constexpr (!std::is_null_pointer_v<Loop>) {
+            const auto out = std::make_unique<R[]>(n);
+            const double seconds = seconds_per_run(options, [&, p = in.pointers, o = out.get()] {
+                for (size_t i = 0; i < n; ++i) {
+                    o[i] = loop(p, i);
+                }
+            });
+            sink = static_cast<double>(out[n / 2]);
+            report("loop", op, type_name<T>(), n, depth, seconds, bytes);
+        }
+        if constexpr (!std::is_null_pointer_v<Array>) {
+            std::valarray<R> out(n);
+            const double seconds = seconds_per_run(options, [&] { array(out, in.arrays); });
+            sink = static_cast<double>(out[n / 2]);
+            report("valarray", op, type_name<T>(), n, depth, seconds, bytes);
+        }
+    }
+
+    /* Lift a function of some operands to the operand lists of compare(), with nullptr passed through */
+    template <size_t... I>
+    auto on(auto f) {
+        if constexpr (std::is_null_pointer_v<decltype(f)>) {
+            return nullptr;
+        } else {
+            return [f](const auto& operands) { return f(operands[I]...); };
+        }
+    }
+
+    template <size_t... I>
+    auto at(auto f) {
+        if constexpr (std::is_null_pointer_v<decltype(f)>) {
+            return nullptr;
+        } else {
+            return [f](const auto& p, size_t i) { return f(p[I][i]...); };
+        }
+    }
+
+    template <size_t... I>
+    auto into(auto f) {
+        if constexpr (std::is_null_pointer_v<decltype(f)>) {
+            return nullptr;
+        } else {
+            return [f](auto& out, const auto& operands) { f(out, operands[I]...); };
+        }
+    }
+
+    template <typename T, size_t A = 0>
+    void unary(const Options& o, const Operands<T>& in, std::string_view op, auto expr, auto loop, auto array) {
+        compare(o, op, 1, in, 1, on<A>(expr), at<A>(loop), into<A>(array));
+    }
+
+    template <typename T>
+    void binary(const Options& o, const Operands<T>& in, std::string_view op, auto expr, auto loop, auto array) {
+        compare(o, op, 1, in, 2, on<0, 1>(expr), at<0, 1>(loop), into<0, 1>(array));
+    }
+
+    /* Both accuracy tiers of a transcendental; the fast tier has no counterpart in the baselines. A is the operand
+     * whose range suits the function's domain. */
+    template <size_t A, typename T>
+    void transcendental(const Options& o, const Operands<T>& in, std::string_view op, auto expr, auto loop,
+                        auto array) {
+        unary<T, A>(o, in, op, [expr](const auto& x) { return expr.template operator()<Accuracy::precise>(x); },
+                    loop, array);
+        unary<T, A>(o, in, std::string(op) + "_fast",
+                    [expr](const auto& x) { return expr.template operator()<Accuracy::fast>(x); }, nullptr, nullptr);
+    }
+
+    template <typename T>
+    void floating_ops(const Options& o, const Operands<T>& in) {
+        transcendental<0>(o, in, "exp", []<Accuracy A>(const auto& x) { return x.template exp<A>(); },
+                          [](T x) { return std::exp(x); }, [](auto& out, const auto& x) { out = std::exp(x); });
+        transcendental<1>(o, in, "log", []<Accuracy A>(const auto& x) { return x.template log<A>(); },
+                          [](T x) { return std::log(x); }, [](auto& out, const auto& x) { out = std::log(x); });
+        transcendental<1>(o, in, "log10", []<Accuracy A>(const auto& x) { return x.template log10<A>(); },
+                          [](T x) { return std::log10(x); }, [](auto& out, const auto& x) { out = std::log10(x); });
+        transcendental<1>(o, in, "sin", []<Accuracy A>(const auto& x) { return x.template sin<A>(); },
+                          [](T x) { return std::sin(x); }, [](auto& out, const auto& x) { out = std::sin(x); });
+        transcendental<1>(o, in, "cos", []<Accuracy A>(const auto& x) { return x.template cos<A>(); },
+                          [](T x) { return std::cos(x); }, [](auto& out, const auto& x) { out = std::cos(x); });
+        transcendental<0>(o, in, "tan", []<Accuracy A>(const auto& x) { return x.template tan<A>(); },
+                          [](T x) { return std::tan(x); }, [](auto& out, const auto& x) { out = std::tan(x); });
+        transcendental<0>(o, in, "asin", []<Accuracy A>(const auto& x) { return x.template asin<A>(); },
+                          [](T x) { return std::asin(x); }, [](auto& out, const auto& x) { out = std::asin(x); });
+        transcendental<0>(o, in, "acos", []<Accuracy A>(const auto& x) { return x.template acos<A>(); },
+                          [](T x) { return std::acos(x); }, [](auto& out, const auto& x) { out = std::acos(x); });
+        transcendental<1>(o, in, "atan", []<Accuracy A>(const auto& x) { return x.template atan<A>(); },
+                          [](T x) { return std::atan(x); }, [](auto& out, const auto& x) { out = std::atan(x); });
+        transcendental<0>(o, in, "sinh", []<Accuracy A>(const auto& x) { return x.template sinh<A>(); },
+                          [](T x) { return std::sinh(x); }, [](auto& out, const auto& x) { out = std::sinh(x); });
+        transcendental<0>(o, in, "cosh", []<Accuracy A>(const auto& x) { return x.template cosh<A>(); },
+                          [](T x) { return std::cosh(x); }, [](auto& out, const auto& x) { out = std::cosh(x); });
+        transcendental<0>(o, in, "tanh", []<Accuracy A>(const auto& x) { return x.template tanh<A>(); },
+                          [](T x) { return std::tanh(x); }, [](auto& out, const auto& x) { out = std::tanh(x); });
+        transcendental<1>(o, in, "asinh", []<Accuracy A>(const auto& x) { return x.template asinh<A>(); },
+                          [](T x) { return std::asinh(x); }, nullptr);
+        transcendental<1>(o, in, "acosh", []<Accuracy A>(const auto& x) { return x.template acosh<A>(); },
+                          [](T x) { return std::acosh(x); }, nullptr);
+        transcendental<0>(o, in, "atanh", []<Accuracy A>(const auto& x) { return x.template atanh<A>(); },
+                          [](T x) { return std::atanh(x); }, nullptr);
+
+        unary(o, in, "sqrt", [](const auto& x) { return x.sqrt(); }, [](T x) { return std::sqrt(x); },
+              [](auto& out, const auto& x) { out = std::sqrt(x); });
+        binary(o, in, "pow", [](const auto& x, const auto& y) { return x.pow(y); },
+               [](T x, T y) { return std::pow(x, y); },
+               [](auto& out, const auto& x, const auto& y) { out = std::pow(x, y); });
+        unary(o, in, "pow_scalar_2.5", [](const auto& x) { return x.pow(T(2.5)); },
+              [](T x) { return std::pow(x, T(2.5)); }, [](auto& out, const auto& x) { out = std::pow(x, T(2.5)); });
+        unary(o, in, "pow_scalar_0.5", [](const auto& x) { return x.pow(T(0.5)); },
+              [](T x) { return std::pow(x, T(0.5)); }, [](auto& out, const auto& x) { out = std::pow(x, T(0.5)); });
+        compare(o, "fma", 1, in, 3, on<0, 1, 2>([](const auto& x, const auto& y, const auto& z) { return x * y + z; }),
+                at<0, 1, 2>([](T x, T y, T z) { return x * y + z; }),
+                into<0, 1, 2>([](auto& out, const auto& x, const auto& y, const auto& z) { out = x * y + z; }));
+    }
+
+    /* Bitwise operators yield bool here, so the baselines test the result against zero as well */
+    template <typename T>
+    void integral_ops(const Options& o, const Operands<T>& in) {
+        unary(o, in, "bit_not", [](const auto& x) { return ~x; }, [](T x) { return T(~x); },
+              [](auto& out, const auto& x) { out = ~x; });
+        binary(o, in, "mod", [](const auto& x, const auto& y) { return x % y; }, [](T x, T y) { return T(x % y); },
+               [](auto& out, const auto& x, const auto& y) { out = x % y; });
+        binary(o, in, "bit_and", [](const auto& x, const auto& y) { return x & y; },
+               [](T x, T y) { return (x & y) != 0; },
+               [](auto& out, const auto& x, const auto& y) { out = (x & y) != 0; });
+        binary(o, in, "bit_or", [](const auto& x, const auto& y) { return x | y; },
+               [](T x, T y) { return (x | y) != 0; },
+               [](auto& out, const auto& x, const auto& y) { out = (x | y) != 0; });
+        binary(o, in, "bit_xor", [](const auto& x, const auto& y) { return x ^ y; },
+               [](T x, T y) { return (x ^ y) != 0; },
+               [](auto& out, const auto& x, const auto& y) { out = (x ^ y) != 0; });
+        unary(o, in, "pow_scalar_3", [](const auto& x) { return x.pow(3u); }, [](T x) { return T(x * x * x); },
+              nullptr);
+        /* A divisor known only at run time, like a bucket size or shard count */
+        const T d = in.tensors[1][0];
+        unary(o, in, "div_scalar", [d](const auto& x) { return x / d; }, [d](T x) { return T(x / d); },
+              [d](auto& out, const auto& x) { out = x / d; });
+        unary(o, in, "mod_scalar", [d](const auto& x) { return x % d; }, [d](T x) { return T(x % d); },
+              [d](auto& out, const auto& x) { out = x % d; });
+    }
+
+    template <typename T>
+    void common_ops(const Options& o, const Operands<T>& in) {
+        unary(o, in, "neg", [](const auto& x) { return -x; }, [](T x) { return T(-x); },
+              [](auto& out, const auto& x) { out = -x; });
+        unary(o, in, "abs", [](const auto& x) { return x.abs(); }, [](T x) { return std::abs(x); },
+              [](auto& out, const auto& x) { out = std::abs(x); });
+        binary(o, in, "add", [](const auto& x, const auto& y) { return x + y; }, [](T x, T y) { return T(x + y); },
+               [](auto& out, const auto& x, const auto& y) { out = x + y; });
+        binary(o, in, "sub", [](const auto& x, const auto& y) { return x - y; }, [](T x, T y) { return T(x - y); },
+               [](auto& out, const auto& x, const auto& y) { out = x - y; });
+        binary(o, in, "mul", [](const auto& x, const auto& y) { return x * y; }, [](T x, T y) { return T(x * y); },
+               [](auto& out, const auto& x, const auto& y) { out = x * y; });
+        binary(o, in, "div", [](const auto& x, const auto& y) { return x / y; }, [](T x, T y) { return T(x / y); },
+               [](auto& out, const auto& x, const auto& y) { out = x / y; });
+        binary(o, in, "eq", [](const auto& x, const auto& y) { return x == y; }, [](T x, T y) { return x == y; },
+               [](auto& out, const auto& x, const auto& y) { out = x == y; });
+        binary(o, in, "ne", [](const auto& x, const auto& y) { return x != y; }, [](T x, T y) { return x != y; },
+               [](auto& out, const auto& x, const auto& y) { out = x != y; });
+        binary(o, in, "lt", [](const auto& x, const auto& y) { return x < y; }, [](T x, T y) { return x < y; },
+               [](auto& out, const auto& x, const auto& y) { out = x < y; });
+        binary(o, in, "le", [](const auto& x, const auto& y) { return x <= y; }, [](T x, T y) { return x <= y; },
+               [](auto& out, const auto& x, const auto& y) { out = x <= y; });
+        binary(o, in, "gt", [](const auto& x, const auto& y) { return x > y; }, [](T x, T y) { return x > y; },
+               [](auto& out, const auto& x, const auto& y) { out = x > y; });
+        binary(o, in, "ge", [](const auto& x, const auto& y) { return x >= y; }, [](T x, T y) { return x >= y; },
+               [](auto& out, const auto& x, const auto& y) { out = x >= y; });
+        binary(o, in, "min", [](const auto& x, const auto& y) { return detail::BinaryExpr{x, y, detail::MinOp{}}; },
+               [](T x, T y) { return std::min(x, y); }, nullptr);
+        binary(o, in, "max", [](const auto& x, const auto& y) { return detail::BinaryExpr{x, y, detail::MaxOp{}}; },
+               [](T x, T y) { return std::max(x, y); }, nullptr);
+        binary(o, in, "where", [](const auto& x, const auto& y) { return where(x < y, x, y); },
+               [](T x, T y) { return x < y ? x : y; }, [](auto& out, const auto& x, const auto& y) {
+                   out = y;
+                   out[x < y] = x[x < y];
+               });
+        unary(o, in, "pow_const_3", [](const auto& x) { return x.template pow<3>(); },
+              [](T x) { return T(x * x * x); }, [](auto& out, const auto& x) { out = x * x * x; });
+        unary(o, in, "pow_const_8", [](const auto& x) { return x.template pow<8>(); }, [](T x) {
+            const T x2 = x * x;
+            const T x4 = x2 * x2;
+            return T(x4 * x4);
+        }, nullptr);
+    }
+
+    /* 16-bit storage, computed in float; there is no valarray baseline, as valarray arithmetic needs a built-in type */
+    template <typename T>
+    void half_ops(const Options& o, const Operands<T>& in) {
+        unary(o, in, "neg", [](const auto& x) { return -x; }, [](T x) { return T(-x); }, nullptr);
+        binary(o, in, "add", [](const auto& x, const auto& y) { return x + y; }, [](T x, T y) { return T(x + y); },
+               nullptr);
+        binary(o, in, "mul", [](const auto& x, const auto& y) { return x * y; }, [](T x, T y) { return T(x * y); },
+               nullptr);
+        binary(o, in, "lt", [](const auto& x, const auto& y) { return x < y; }, [](T x, T y) { return x < y; },
+               nullptr);
+        binary(o, in, "where", [](const auto& x, const auto& y) { return where(x < y, x, y); },
+               [](T x, T y) { return x < y ? x : y; }, nullptr);
+        compare(o, "madd", 1, in, 3, [](const auto& t) { return t[0] * t[1] + t[2]; },
+                [](const auto& p, size_t i) { return T(p[0][i] * p[1][i] + p[2][i]); }, nullptr);
+        transcendental<0>(o, in, "exp", []<Accuracy A>(const auto& x) { return x.template exp<A>(); },
+                          [](T x) { return T(std::exp(float(x))); }, nullptr);
+    }
+
+    /* The same filter work into a bit-packed Mask ("mask") and into Tensor<bool> ("tensor"): evaluating a
+     * comparison, combining four masks, and counting the true elements. A mask element is an eighth of a byte. */
+    template <typename T>
+    void mask_ops(const Options& o, const Operands<T>& in) {
+        const size_t n = in.size();
+        const auto& t = in.tensors;
+        const auto time = [&](std::string_view op, std::string_view impl, double bytes, auto&& f) {
+            if (op.find(o.filter) != std::string_view::npos) {
+                report(impl, op, type_name<T>(), n, 1, seconds_per_run(o, f), bytes);
+            }
+        };
+        const Mask<> m[] = {t[0] < t[2], t[1] < t[3], t[0] < 0.5, t[1] > 2.5};
+        const Tensor<bool> b[] = {t[0] < t[2], t[1] < t[3], t[0] < 0.5, t[1] > 2.5};
+        Mask<> mask_out(Shape{n});
+        Tensor<bool> bool_out(Shape{n});
+        time("mask_lt", "mask", 2 * sizeof(T) + 0.125, [&] { mask_out = t[0] < t[2]; });
+        time("mask_lt", "tensor", 2 * sizeof(T) + 1.0, [&] { bool_out = t[0] < t[2]; });
+        time("mask_combine", "mask", 5 * 0.125, [&] { mask_out = (m[0] & m[1] & ~m[2]) | m[3]; });
+        time("mask_combine", "tensor", 5 * 1.0, [&] { bool_out = (b[0] & b[1] & ~b[2]) | b[3]; });
+        time("mask_count", "mask", 0.125, [&] { sink = static_cast<double>(m[0].count()); });
+        time("mask_count", "tensor", 1.0, [&] { sink = static_cast<double>(sum(b[0])); });
+    }
+
+    /* Keeping the elements of one operand where a comparison holds, about half of them, against the branchy loop */
+    template <typename T>
+    void compress_ops(const Options& o, const Operands<T>& in) {
+        const size_t n = in.size();
+        const auto& t = in.tensors;
+        const T* x = in.pointers[0];
+        const T* y = in.pointers[2];
+        const auto time = [&](std::string_view op, std::string_view impl, auto&& f) {
+            if (op.find(o.filter) != std::string_view::npos) {
+                report(impl, op, type_name<T>(), n, 1, seconds_per_run(o, f), 2 * sizeof(T) + sizeof(T) / 2.0);
+            }
+        };
+        time("compress", "tensor", [&] { sink = static_cast<double>(compress(t[0] < t[2], t[0]).size()); });
+        const auto out = std::make_unique<T[]>(n);
+        time("compress", "loop", [&, o = out.get()] {
+            size_t k = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (x[i] < y[i]) {
+                    o[k++] = x[i];
+                }
+            }
+            sink = static_cast<double>(k);
+        });
+    }
+
+    /* Running sums and maxima of a fused expression, into existing storage, against the serial loop */
+    template <typename T>
+    void scan_ops(const Options& o, const Operands<T>& in) {
+        using A = detail::accumulator_type<T>;
+        const size_t n = in.size();
+        const auto& t = in.tensors;
+        const T* x = in.pointers[0];
+        const T* y = in.pointers[1];
+        const auto time = [&](std::string_view op, std::string_view impl, double bytes, auto&& f) {
+            if (op.find(o.filter) != std::string_view::npos) {
+                report(impl, op, type_name<T>(), n, 1, seconds_per_run(o, f), bytes);
+            }
+        };
+        Tensor<A> sums(Shape{n});
+        Tensor<T> maxima(Shape{n});
+        time("cumsum", "tensor", 2 * sizeof(T) + sizeof(A), [&] { cumsum(TensorView(sums), t[0] * t[1]); });
+        time("cumsum", "loop", 2 * sizeof(T) + sizeof(A), [&, out = sums.data()] {
+            A running = 0;
+            for (size_t i = 0; i < n; ++i) {
+                running += static_cast<A>(x[i] * y[i]);
+                out[i] = running;
+            }
+        });
+        time("cummax", "tensor", 2 * sizeof(T), [&] { cummax(TensorView(maxima), t[0]); });
+        time("cummax", "loop", 2 * sizeof(T), [&, out = maxima.data()] {
+            T running = std::numeric_limits<T>::lowest();
+            for (size_t i = 0; i < n; ++i) {
+                running = x[i] > running ? x[i] : running;
+                out[i] = running;
+            }
+        });
+        sink = static_cast<double>(sums.data()[n / 2]) + static_cast<double>(maxima.data()[n / 2]);
+    }
+
+    /* a + b*c + c*d + d*a + ... with Depth products, written out in full in every implementation */
+    template <typename T, size_t Depth>
+    void depth_chain(const Options& o, const Operands<T>& in) {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            compare(o, "madd_chain", Depth, in, Depth == 1 ? 3 : 4,
+                    [](const auto& t) { return (t[0] + ... + (t[(I + 1) % 4] * t[(I + 2) % 4])); },
+                    [](const auto& p, size_t i) { return (p[0][i] + ... + (p[(I + 1) % 4][i] * p[(I + 2) % 4][i])); },
+                    [](auto& out, const auto& v) { out = (v[0] + ... + (v[(I + 1) % 4] * v[(I + 2) % 4])); });
+        }(std::make_index_sequence<Depth>{});
+    }
+
+    template <typename T>
+    void run(const Options& o) {
+        for (size_t n : o.sizes) {
+            const Operands<T> in(n);
+            if constexpr (detail::half_floating<T>) {
+                half_ops(o, in);
+            } else {
+                common_ops(o, in);
+                if constexpr (std::is_same_v<T, float>) {
+                    mask_ops(o, in);
+                }
+                scan_ops(o, in);
+                compress_ops(o, in);
+                if constexpr (std::is_floating_point_v<T>) {
+                    floating_ops(o, in);
+                } else {
+                    integral_ops(o, in);
+                }
+                [&]<size_t... D>(std::index_sequence<D...>) {
+                    (depth_chain<T, D + 1>(o, in), ...);
+                }(std::make_index_sequence<10>{});
+            }
+        }
+    }
+
+    [[noreturn]] void usage() {
+        std::fprintf(stderr, "usage: benchmark [--filter SUBSTRING] [--sizes N,N,...] [--min-time SECONDS] "
+                             "[--threads N]\n");
+        std::exit(2);
+    }
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view flag = argv[i];
+            if (i + 1 >= argc) {
+                usage();
+            }
+            const char* value = argv[++i];
+            if (flag == "--filter") {
+                options.filter = value;
+            } else if (flag == "--min-time") {
+                options.min_time = std::strtod(value, nullptr);
+            } else if (flag == "--threads") {
+                options.threads = std::strtoull(value, nullptr, 10);
+            } else if (flag == "--sizes") {
+                options.sizes.clear();
+                for (char* p = const_cast<char*>(value); *p != '\0';) {
+                    const size_t n = std::strtoull(p, &p, 10);
+                    if (n == 0) {
+                        usage();
+                    }
+                    options.sizes.push_back(n);
+                    p += *p == ',';
+                }
+            } else {
+                usage();
+            }
+        }
+        return options;
+    }
+} // namespace
+
+
+int main(int argc, char** argv) {
+    const Options options = parse(argc, argv);
+    set_num_threads(options.threads);
+    std::printf("impl,op,type,elements,depth,ns_per_element,elements_per_second,gigabytes_per_second\n");
+    run<float>(options);
+    run<double>(options);
+    run<int32_t>(options);
+    run<float16>(options);
+    run<bfloat16>(options);
+    return 0;
+}
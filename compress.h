@@ -0,0 +1,139 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "mask.h"
+
+
+/* Stream compaction: the elements of an expression at the positions where a condition holds, packed together in order.
+ * The condition is any expression, taken for its truth as in where(); a Mask, or logic over Masks, is read a word at a
+ * time. Condition and values are evaluated together a block at a time, the condition into bits and the values only in
+ * the packets where some bit is set, and neither is stored whole. */
+
+namespace detail {
+    /* Elements per step: a multiple of every packet size and of the 64 bits of a condition word */
+    inline constexpr size_t compress_block = 1024;
+
+    /* The values nonzero() packs: element i is its own flat index */
+    struct Positions {
+        template <size_t N>
+        [[nodiscard]] Packet<int64_t, N> packet(size_t i) const {
+            Packet<int64_t, N> p;
+            for (size_t l = 0; l < N; ++l) {
+                p.set(l, static_cast<int64_t>(i + l));
+            }
+            return p;
+        }
+
+        [[nodiscard]] int64_t operator[](size_t i) const {
+            return static_cast<int64_t>(i);
+        }
+    };
+
+    /* Number of elements of [first, last) where cond holds; first is a multiple of 64 */
+    template <typename C>
+    size_t count_true(const C& cond, size_t first, size_t last) {
+        uint64_t words[compress_block / mask_word_bits];
+        size_t total = 0;
+        for (size_t begin = first; begin < last; begin += compress_block) {
+            const size_t end = std::min(begin + compress_block, last);
+            evaluate_words(words, cond, begin / mask_word_bits, mask_words(end));
+            for (size_t w = 0; w < mask_words(end - begin); ++w) {
+                const uint64_t used = w + 1 < mask_words(end - begin) ? ~uint64_t{0} : mask_tail(end - begin);
+                total += static_cast<size_t>(std::popcount(words[w] & used));
+            }
+        }
+        return total;
+    }
+
+    /* Writes the values of [first, last) where cond holds to out, in order, and returns how many there were. Each
+     * block is packed on the stack first, since the packed stores run past the last selected element. */
+    template <numeric T, typename C, typename V>
+    size_t compress_range(T* out, const C& cond, const V& values, size_t first, size_t last) {
+        constexpr size_t N = packet_size<T>;
+        constexpr uint64_t lanes = N == mask_word_bits ? ~uint64_t{0} : (uint64_t{1} << N) - 1;
+        static_assert(mask_word_bits % N == 0);
+        uint64_t words[compress_block / mask_word_bits];
+        alignas(64) T packed[compress_block + N];
+        size_t written = 0;
+        for (size_t begin = first; begin < last; begin += compress_block) {
+            const size_t end = std::min(begin + compress_block, last);
+            evaluate_words(words, cond, begin / mask_word_bits, mask_words(end));
+            size_t k = 0;
+            size_t i = begin;
+            for (; i + N <= end; i += N) {
+                const uint64_t bits = words[(i - begin) / mask_word_bits] >> (i - begin) % mask_word_bits & lanes;
+                if (bits != 0) {
+                    k += compress_store(packed + k, values.template packet<N>(i), bits);
+                }
+            }
+            for (; i < end; ++i) {
+                packed[k] = static_cast<T>(values[i]);
+                k += words[(i - begin) / mask_word_bits] >> (i - begin) % mask_word_bits & 1;
+            }
+            std::copy_n(packed, k, out + written);
+            written += k;
+        }
+        return written;
+    }
+
+    /* Inputs below the parallel threshold take one pass into a buffer as large as the input, of which only the
+     * selected part is ever touched. Larger ones, even on a single thread, never hold more than the result: every
+     * grain is counted first, a scan of the counts gives each its place in the result, and the grains are packed
+     * there in parallel. */
+    template <numeric T, typename C, typename V>
+    [[nodiscard]] Tensor<T> compressed(const C& cond, const V& values) {
+        constexpr size_t grain = parallel_grain<T>;
+        static_assert(grain % compress_block == 0);
+        [[maybe_unused]] const auto probe = profile(EvaluationProfile::Kind::compress, cond, packet_size<T>, grain,
+                                                    sizeof(T));
+        const size_t count = cond.size();
+        if (count < parallel_threshold()) {
+            const auto buffer = std::make_unique_for_overwrite<T[]>(count);
+            return Tensor<T>(buffer.get(), compress_range(buffer.get(), cond, values, 0, count));
+        }
+
+        std::vector<size_t> offsets((count + grain - 1) / grain + 1);
+        thread_pool().parallel_for(count, grain, [&](size_t first, size_t last) {
+            for (size_t begin = first; begin < last; begin += grain) {
+                offsets[begin / grain + 1] = count_true(cond, begin, std::min(begin + grain, last));
+            }
+        });
+        for (size_t g = 1; g < offsets.size(); ++g) {
+            offsets[g] += offsets[g - 1];
+        }
+        Tensor<T> result(Shape(offsets.back()));
+        thread_pool().parallel_for(count, grain, [&](size_t first, size_t last) {
+            for (size_t begin = first; begin < last; begin += grain) {
+                compress_range(result.data() + offsets[begin / grain], cond, values, begin,
+                               std::min(begin + grain, last));
+            }
+        });
+        return result;
+    }
+} // namespace detail
+
+
+/* The elements of values where cond holds, in order, as a one-dimensional tensor. compress(x > 0, x) is the filter
+ * that keeps the positive elements of x. Throws std::invalid_argument unless cond and values have the same shape. */
+template <std::derived_from<detail::Expr> C, std::derived_from<detail::Expr> V>
+[[nodiscard]] Tensor<typename V::element_type> compress(const C& cond, const V& values) {
+    if (cond.shape() != values.shape()) {
+        throw std::invalid_argument("Compress: condition of shape " + cond.shape().to_string() +
+                                    " does not match values of shape " + values.shape().to_string());
+    }
+    return detail::compressed<typename V::element_type>(detail::simplify(cond), detail::simplify(values));
+}
+
+/* The flat indices of the elements where cond holds, in ascending order; gather() takes them back to the elements */
+template <std::derived_from<detail::Expr> C>
+[[nodiscard]] Tensor<int64_t> nonzero(const C& cond) {
+    return detail::compressed<int64_t>(detail::simplify(cond), detail::Positions{});
+}
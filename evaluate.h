@@ -0,0 +1,341 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "operator.h"
+#include "parallel.h"
+#include "profile.h"
+#include "simd.h"
+#include "type_helper.h"
+
+
+/* How sum() and the reductions built on it add floating-point values */
+enum class Summation {
+    naive,    /* a single pass with several packet accumulators */
+    pairwise, /* recursive halving over blocks, error grows with log(n) */
+    kahan,    /* compensated addition, error independent of n at about four times the cost */
+};
+
+
+namespace detail {
+    /* Packets over [first, last) while a full one fits, then a scalar tail; element i goes to window[i - first] */
+    template <numeric T, typename E>
+    constexpr void evaluate_window(T* window, const E& expr, size_t first, size_t last) {
+        constexpr size_t N = packet_size<T>;
+        if !consteval {
+            /* Broadcast operands only have contiguous packets within a row, so run the SIMD loop row by row */
+            if (const size_t inner = expr.shape().back(); expr.broadcasting() && inner >= N && inner < last - first) {
+                for (size_t row = first; row < last;) {
+                    const size_t end = std::min(last, (row / inner + 1) * inner);
+                    evaluate_window(window + (row - first), expr, row, end);
+                    row = end;
+                }
+                return;
+            }
+        }
+        size_t i = first;
+        if !consteval {
+            for (; i + N <= last; i += N) {
+                expr.template packet<N>(i).store_as(window + (i - first));
+            }
+        }
+        for (; i < last; ++i) {
+            window[i - first] = static_cast<T>(expr[i]);
+        }
+    }
+
+    template <numeric T, typename E>
+    constexpr void evaluate(T* out, const E& expr, size_t first, size_t last) {
+        evaluate_window(out + first, expr, first, last);
+    }
+
+    /* Elements of T written per parallel task: large enough to amortize scheduling, small enough to stay in L2 */
+    template <numeric T>
+    inline constexpr size_t parallel_grain = std::max(packet_size<T>, (size_t{64} << 10) / sizeof(T));
+
+    template <numeric T, typename E>
+    void evaluate(T* out, const E& expr) {
+        [[maybe_unused]] const auto probe = profile(EvaluationProfile::Kind::assign, expr, packet_size<T>,
+                                                    parallel_grain<T>, sizeof(T));
+        const size_t count = expr.size();
+        if (count < parallel_threshold()) {
+            evaluate(out, expr, 0, count);
+        } else {
+            thread_pool().parallel_for(count, parallel_grain<T>, [&](size_t first, size_t last) {
+                evaluate(out, expr, first, last);
+            });
+        }
+    }
+
+    /* As evaluate, but element i is written to out[i * stride]; lanes are scattered unless the stride is 1 or -1 */
+    template <numeric T, typename E>
+    void evaluate_strided(T* out, ptrdiff_t stride, const E& expr, size_t first, size_t last) {
+        constexpr size_t N = packet_size<T>;
+        if (stride == 1) {
+            evaluate(out, expr, first, last);
+            return;
+        }
+        size_t i = first;
+        for (; i + N <= last; i += N) {
+            const auto p = expr.template packet<N>(i).template as<T>();
+            if (stride == -1) {
+                p.reverse().store(out - static_cast<ptrdiff_t>(i + N - 1));
+            } else {
+                for (size_t k = 0; k < N; ++k) {
+                    out[static_cast<ptrdiff_t>(i + k) * stride] = p[k];
+                }
+            }
+        }
+        for (; i < last; ++i) {
+            out[static_cast<ptrdiff_t>(i) * stride] = static_cast<T>(expr[i]);
+        }
+    }
+
+    template <numeric T, typename E>
+    void evaluate_strided(T* out, ptrdiff_t stride, const E& expr) {
+        [[maybe_unused]] const auto probe = profile(EvaluationProfile::Kind::assign, expr, packet_size<T>,
+                                                    parallel_grain<T>, sizeof(T));
+        const size_t count = expr.size();
+        if (count < parallel_threshold()) {
+            evaluate_strided(out, stride, expr, 0, count);
+        } else {
+            thread_pool().parallel_for(count, parallel_grain<T>, [&](size_t first, size_t last) {
+                evaluate_strided(out, stride, expr, first, last);
+            });
+        }
+    }
+
+    /* Whether some element of [first, last) has truthiness Truth; stops at the first deciding block or once found is
+     * set */
+    template <bool Truth, typename E>
+    bool contains(const E& expr, size_t first, size_t last, const std::atomic<bool>& found) {
+        constexpr size_t N = packet_size<typename E::element_type>;
+        constexpr size_t block = 4 * N;
+        size_t i = first;
+        for (; i + block <= last; i += block) {
+            if (found.load(std::memory_order_relaxed)) {
+                return true;
+            }
+            auto acc = expr.template packet<N>(i).template as<bool>();
+            for (size_t k = N; k < block; k += N) {
+                const auto p = expr.template packet<N>(i + k).template as<bool>();
+                acc = Truth ? acc | p : acc & p;
+            }
+            if (Truth ? any_of(acc) : !all_of(acc)) {
+                return true;
+            }
+        }
+        for (; i < last; ++i) {
+            if (static_cast<bool>(expr[i]) == Truth) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <bool Truth, typename E>
+    bool contains(const E& expr) {
+        using T = typename E::element_type;
+        [[maybe_unused]] const auto probe = profile(EvaluationProfile::Kind::test, expr, packet_size<T>,
+                                                    parallel_grain<T>, 0);
+        const size_t count = expr.size();
+        std::atomic<bool> found = false;
+        if (count < parallel_threshold()) {
+            return contains<Truth>(expr, 0, count, found);
+        }
+        thread_pool().parallel_for(count, parallel_grain<T>, [&](size_t first, size_t last) {
+            if (contains<Truth>(expr, first, last, found)) {
+                found.store(true, std::memory_order_relaxed);
+            }
+        });
+        return found;
+    }
+
+    /* Integers are reduced in 64 bits so that sums of small types do not wrap, and 16-bit floats in float */
+    template <numeric T>
+    using accumulator_type = std::conditional_t<floating<compute_type<T>>, compute_type<T>,
+                             std::conditional_t<signed_integral<T>, int64_t, uint64_t>>;
+
+    template <numeric A, typename Op>
+    [[nodiscard]] constexpr A identity_of(Op) {
+        using limits = std::numeric_limits<A>;
+        if constexpr (std::is_same_v<Op, AddOp>) {
+            return A{0};
+        } else if constexpr (std::is_same_v<Op, MulOp>) {
+            return A{1};
+        } else if constexpr (std::is_same_v<Op, MinOp>) {
+            return limits::has_infinity ? limits::infinity() : limits::max();
+        } else {
+            static_assert(std::is_same_v<Op, MaxOp>);
+            return limits::has_infinity ? -limits::infinity() : limits::lowest();
+        }
+    }
+
+    /* Folds [first, last) with four independent packet accumulators to hide the latency of op */
+    template <numeric A, typename E, typename Op>
+    A fold(const E& expr, size_t first, size_t last, Op op) {
+        constexpr size_t N = packet_size<A>;
+        constexpr size_t K = 4;
+        A result = identity_of<A>(op);
+        size_t i = first;
+        if (last - first >= K * N) {
+            Packet<A, N> acc[K];
+            for (auto& a : acc) {
+                a = Packet<A, N>::broadcast(result);
+            }
+            for (; i + K * N <= last; i += K * N) {
+                for (size_t k = 0; k < K; ++k) {
+                    acc[k] = op(acc[k], expr.template packet<N>(i + k * N).template as<A>());
+                }
+            }
+            for (; i + N <= last; i += N) {
+                acc[0] = op(acc[0], expr.template packet<N>(i).template as<A>());
+            }
+            acc[0] = op(op(acc[0], acc[1]), op(acc[2], acc[3]));
+            for (size_t l = 0; l < N; ++l) {
+                result = op(result, acc[0][l]);
+            }
+        }
+        for (; i < last; ++i) {
+            result = op(result, static_cast<A>(expr[i]));
+        }
+        return result;
+    }
+
+    template <numeric A, typename E>
+    A pairwise_sum(const E& expr, size_t first, size_t last) {
+        constexpr size_t block = 32 * packet_size<A>;
+        if (last - first <= block) {
+            return fold<A>(expr, first, last, AddOp{});
+        }
+        const size_t middle = first + ((last - first) / 2 + block - 1) / block * block;
+        return pairwise_sum<A>(expr, first, middle) + pairwise_sum<A>(expr, middle, last);
+    }
+
+    /* Neumaier's variant of Kahan summation, run independently in every lane */
+    template <numeric A, size_t N>
+    struct KahanAccumulator {
+        Packet<A, N> sum = Packet<A, N>::broadcast(0);
+        Packet<A, N> compensation = Packet<A, N>::broadcast(0);
+
+        void add(const Packet<A, N>& x) {
+            const auto t = sum + x;
+            const auto big = select(AbsOp{}(x) <= AbsOp{}(sum), sum, x);
+            const auto small = select(AbsOp{}(x) <= AbsOp{}(sum), x, sum);
+            compensation = compensation + ((big - t) + small);
+            sum = t;
+        }
+
+        [[nodiscard]] A total() const {
+            KahanAccumulator<A, 1> scalar;
+            for (size_t l = 0; l < N; ++l) {
+                scalar.add(Packet<A, 1>::broadcast(sum[l]));
+                scalar.add(Packet<A, 1>::broadcast(compensation[l]));
+            }
+            return scalar.sum[0] + scalar.compensation[0];
+        }
+    };
+
+    template <numeric A, typename E>
+    A kahan_sum(const E& expr, size_t first, size_t last) {
+        constexpr size_t N = packet_size<A>;
+        KahanAccumulator<A, N> acc;
+        size_t i = first;
+        for (; i + N <= last; i += N) {
+            acc.add(expr.template packet<N>(i).template as<A>());
+        }
+        Packet<A, N> tail = Packet<A, N>::broadcast(0);
+        for (size_t l = 0; i < last; ++i, ++l) {
+            tail.set(l, static_cast<A>(expr[i]));
+        }
+        acc.add(tail);
+        return acc.total();
+    }
+
+    /* Partials are always taken over fixed grains and combined in index order, so the result does not
+     * depend on the thread count or on whether the reduction ran in parallel */
+    template <numeric A, typename E, typename Fold, typename Combine>
+    A reduce(const E& expr, Fold fold_range, Combine combine) {
+        constexpr size_t grain = parallel_grain<A>;
+        [[maybe_unused]] const auto probe = profile(EvaluationProfile::Kind::reduce, expr, packet_size<A>, grain, 0);
+        const size_t count = expr.size();
+        if (count <= grain) {
+            return fold_range(size_t{0}, count);
+        }
+
+        std::vector<A> partials((count + grain - 1) / grain);
+        auto body = [&](size_t first, size_t last) {
+            for (size_t begin = first; begin < last; begin += grain) {
+                partials[begin / grain] = fold_range(begin, std::min(begin + grain, last));
+            }
+        };
+        if (count < parallel_threshold()) {
+            body(0, count);
+        } else {
+            thread_pool().parallel_for(count, grain, body);
+        }
+        return combine(std::span<const A>(partials));
+    }
+
+    template <numeric A, typename Op>
+    A combine_in_order(std::span<const A> partials, Op op) {
+        A result = identity_of<A>(op);
+        for (A partial : partials) {
+            result = op(result, partial);
+        }
+        return result;
+    }
+
+    template <numeric A>
+    A combine_pairwise(std::span<const A> partials) {
+        if (partials.size() == 1) {
+            return partials[0];
+        }
+        const size_t middle = partials.size() / 2;
+        return combine_pairwise(partials.first(middle)) + combine_pairwise(partials.subspan(middle));
+    }
+
+    template <numeric A>
+    A combine_kahan(std::span<const A> partials) {
+        KahanAccumulator<A, 1> acc;
+        for (A partial : partials) {
+            acc.add(Packet<A, 1>::broadcast(partial));
+        }
+        return acc.total();
+    }
+
+    template <Summation S, typename E>
+    auto reduce_sum(const E& expr) {
+        using A = accumulator_type<typename E::element_type>;
+        if constexpr (!floating<A> || S == Summation::naive) {
+            return reduce<A>(expr, [&](size_t first, size_t last) {
+                return fold<A>(expr, first, last, AddOp{});
+            }, [](std::span<const A> partials) {
+                return combine_in_order(partials, AddOp{});
+            });
+        } else if constexpr (S == Summation::pairwise) {
+            return reduce<A>(expr, [&](size_t first, size_t last) {
+                return pairwise_sum<A>(expr, first, last);
+            }, combine_pairwise<A>);
+        } else {
+            return reduce<A>(expr, [&](size_t first, size_t last) {
+                return kahan_sum<A>(expr, first, last);
+            }, combine_kahan<A>);
+        }
+    }
+
+    template <numeric A, typename E, typename Op>
+    A reduce_with(const E& expr, Op op) {
+        return reduce<A>(expr, [&](size_t first, size_t last) {
+            return fold<A>(expr, first, last, op);
+        }, [&](std::span<const A> partials) {
+            return combine_in_order(partials, op);
+        });
+    }
+} // namespace detail
@@ -0,0 +1,899 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tensor.h"
+#include "tensor_file.h"
+
+
+/* Formulas compiled at run time, for expressions that come from configuration rather than from C++ source. The text
+ * is parsed, its variables are given element types, and the tree is type-checked with the promotions of
+ * common_type_t. It then becomes bytecode for a register machine. Every instruction applies one operator of
+ * operator.h to a block of elements, so the cost of dispatching it is spread over the whole block.
+ *
+ * Binary operators, from loosest to tightest binding as in C:   |   ^   &   == !=   < <= > >=   + -   * / %
+ * Unary - and ~ bind tighter still. Primaries are numbers, variables, parenthesized formulas, and calls:
+ *     abs sqrt exp log log10 sin cos tan asin acos atan sinh cosh tanh asinh acosh atanh    one operand
+ *     pow min max                                                                            two operands
+ *     where(cond, x, y)                                                                      three operands
+ *     bool int8 int16 int32 int64 uint8 uint16 uint32 uint64 float32 float64 float16 bfloat16 conversion
+ * Literals are typed as in C++: 2 is int32, 2.5 is float64 and 2.5f is float32. Before an operator runs, 16-bit
+ * floats are widened to float, and sqrt and the transcendentals take integers as float. A + or - over a floating
+ * product is fused into one multiply-add wherever simplify() would fuse it, so a formula rounds like the same
+ * expression written in C++. */
+
+/* A variable of a formula and the element type it will be bound to */
+struct FormulaVariable {
+    std::string_view name;
+    ElementType type;
+};
+
+/* A tensor bound to a variable by name, whatever its element type. The elements must outlive the evaluation. */
+struct FormulaInput {
+    std::string_view name;
+    ElementType type;
+    const void* data;
+    Shape shape;
+
+    template <detail::numeric T, typename A>
+    FormulaInput(std::string_view name, const Tensor<T, A>& tensor)
+        : name(name), type(detail::element_type_of<T>()), data(tensor.data()), shape(tensor.shape()) {}
+
+    template <detail::numeric T>
+    FormulaInput(std::string_view name, TensorView<T> view)
+        : name(name), type(detail::element_type_of<T>()), data(view.data()), shape(view.shape()) {}
+
+    FormulaInput(std::string_view name, const TensorFile& file);
+};
+
+
+namespace detail {
+    /* In ElementType order, code 1 first */
+    using element_types = std::tuple<bool, int8_t, int16_t, int32_t, int64_t, uint8_t, uint16_t, uint32_t, uint64_t,
+                                     float, double, float16, bfloat16>;
+
+    /* f(std::type_identity<T>{}) for the T that type stands for; a value-initialized result for an unknown code */
+    template <typename F>
+    auto visit_element_type(ElementType type, F&& f) {
+        return [&]<size_t... I>(std::index_sequence<I...>) {
+            decltype(f(std::type_identity<bool>{})) result{};
+            (void) ((static_cast<size_t>(type) == I + 1 &&
+                     (result = f(std::type_identity<std::tuple_element_t<I, element_types>>{}), true)) || ...);
+            return result;
+        }(std::make_index_sequence<std::tuple_size_v<element_types>>{});
+    }
+
+    [[nodiscard]] inline std::string_view element_type_name(ElementType type) {
+        return element_info(static_cast<uint8_t>(type)).name;
+    }
+
+    [[nodiscard]] inline ElementType common_element_type(ElementType a, ElementType b) {
+        return visit_element_type(a, [&]<typename A>(std::type_identity<A>) {
+            return visit_element_type(b, [&]<typename B>(std::type_identity<B>) {
+                return element_type_of<common_type_t<A, B>>();
+            });
+        });
+    }
+
+
+    /* Elements each instruction processes per dispatch; a block of every register stays in L1 */
+    inline constexpr size_t formula_block = 1024;
+
+    /* Largest element, and so the bytes per element of a register or a constant */
+    inline constexpr size_t formula_lane_bytes = 8;
+
+    using FormulaKernel = void (*)(void* dst, const void* const* args, size_t count);
+
+    /* The conversion kernel: store_as() rounds a packet to the destination type once */
+    struct FormulaCopyOp {
+        template <numeric T, size_t N>
+        constexpr Packet<T, N> operator()(const Packet<T, N>& x) const {
+            return x;
+        }
+    };
+
+    template <size_t N, typename Op, numeric R, numeric... A, size_t... K>
+    void formula_step(R* out, const void* const* args, size_t i, std::index_sequence<K...>) {
+        Op{}(Packet<A, N>::load(static_cast<const A*>(args[K]) + i)...).store_as(out + i);
+    }
+
+    /* Op over count elements of the operand arrays, in packets as wide as the result's and then lane by lane */
+    template <typename Op, numeric R, numeric... A>
+    void formula_kernel(void* dst, const void* const* args, size_t count) {
+        constexpr size_t N = packet_size<R>;
+        auto* out = static_cast<R*>(dst);
+        size_t i = 0;
+        for (; i + N <= count; i += N) {
+            formula_step<N, Op, R, A...>(out, args, i, std::index_sequence_for<A...>{});
+        }
+        for (; i < count; ++i) {
+            formula_step<1, Op, R, A...>(out, args, i, std::index_sequence_for<A...>{});
+        }
+    }
+
+    /* Op over the first operand by a divisor that is the same for every element: the constant second operand, which
+     * Op prepares once per block */
+    template <typename Op, integral T>
+    void formula_divisor_kernel(void* dst, const void* const* args, size_t count) {
+        constexpr size_t N = packet_size<T>;
+        const Op op(*static_cast<const T*>(args[1]));
+        const auto* x = static_cast<const T*>(args[0]);
+        auto* out = static_cast<T*>(dst);
+        size_t i = 0;
+        for (; i + N <= count; i += N) {
+            op(Packet<T, N>::load(x + i)).store_as(out + i);
+        }
+        for (; i < count; ++i) {
+            out[i] = op(x[i]);
+        }
+    }
+
+    /* The kernel of x / d or x % d for integers of type and a constant d, or none for other types */
+    [[nodiscard]] inline FormulaKernel formula_divisor_kernel_for(ElementType type, bool modulo) {
+        return visit_element_type(type, [&]<typename T>(std::type_identity<T>) -> FormulaKernel {
+            if constexpr (integral<T>) {
+                return modulo ? &formula_divisor_kernel<ScalarModOp<T, T>, T>
+                              : &formula_divisor_kernel<ScalarDivOp<T, T>, T>;
+            } else {
+                return nullptr;
+            }
+        });
+    }
+
+    struct FormulaKernelInfo {
+        FormulaKernel kernel = nullptr;
+        ElementType result{};
+    };
+
+    /* What a call converts its operands to before its kernel runs */
+    enum class FormulaPromotion {
+        common,   /* all operands to their common type */
+        widened,  /* 16-bit floats to float */
+        floating, /* integers and 16-bit floats to float */
+        select,   /* the condition to bool, the two alternatives to their common type */
+    };
+
+    template <typename Op, typename T, size_t Arity, FormulaPromotion P>
+    concept formula_applicable =
+        !half_floating<T> && (P != FormulaPromotion::floating || floating<T>) &&
+        (!std::is_same_v<Op, ModOp> || integral<T>) &&
+        (Arity == 1   ? std::is_invocable_v<Op, T>
+         : Arity == 2 ? std::is_invocable_v<Op, T, T>
+         : P == FormulaPromotion::select ? std::is_invocable_v<Op, bool, T, T>
+                                         : floating<T> && std::is_invocable_v<Op, T, T, T>);
+
+    /* The kernel of Op over operands of type (after promotion), or none when Op does not apply to it */
+    template <typename Op, size_t Arity, FormulaPromotion P>
+    [[nodiscard]] FormulaKernelInfo formula_kernel_for(ElementType type) {
+        return visit_element_type(type, []<typename T>(std::type_identity<T>) -> FormulaKernelInfo {
+            if constexpr (!formula_applicable<Op, T, Arity, P>) {
+                return {};
+            } else if constexpr (Arity == 1) {
+                using R = typename operator_result<Op, T>::type;
+                return {&formula_kernel<Op, R, T>, element_type_of<R>()};
+            } else if constexpr (Arity == 2) {
+                using R = typename operator_result<Op, T, T>::type;
+                return {&formula_kernel<Op, R, T, T>, element_type_of<R>()};
+            } else if constexpr (P == FormulaPromotion::select) {
+                using R = typename operator_result<Op, bool, T, T>::type;
+                return {&formula_kernel<Op, R, bool, T, T>, element_type_of<R>()};
+            } else {
+                using R = typename operator_result<Op, T, T, T>::type;
+                return {&formula_kernel<Op, R, T, T, T>, element_type_of<R>()};
+            }
+        });
+    }
+
+    [[nodiscard]] inline FormulaKernel conversion_kernel(ElementType from, ElementType to) {
+        return visit_element_type(to, [&]<typename R>(std::type_identity<R>) {
+            return visit_element_type(from, []<typename A>(std::type_identity<A>) {
+                return static_cast<FormulaKernel>(&formula_kernel<FormulaCopyOp, R, A>);
+            });
+        });
+    }
+
+    struct FormulaOperator {
+        std::string_view name;
+        size_t arity;
+        FormulaPromotion promotion;
+        FormulaKernelInfo (*kernel)(ElementType);
+    };
+
+    template <typename Op, size_t Arity, FormulaPromotion P>
+    [[nodiscard]] constexpr FormulaOperator formula_operator(std::string_view name) {
+        return {name, Arity, P, &formula_kernel_for<Op, Arity, P>};
+    }
+
+    /* Operators by the name a call or a symbol refers to; unary - and ~ are neg and compl */
+    inline constexpr std::array formula_operators{
+        formula_operator<NegOp, 1, FormulaPromotion::widened>("neg"),
+        formula_operator<ComplOp, 1, FormulaPromotion::widened>("compl"),
+        formula_operator<AbsOp, 1, FormulaPromotion::widened>("abs"),
+        formula_operator<SqrtOp, 1, FormulaPromotion::floating>("sqrt"),
+        formula_operator<ExpOp<>, 1, FormulaPromotion::floating>("exp"),
+        formula_operator<LogOp<>, 1, FormulaPromotion::floating>("log"),
+        formula_operator<Log10Op<>, 1, FormulaPromotion::floating>("log10"),
+        formula_operator<SinOp<>, 1, FormulaPromotion::floating>("sin"),
+        formula_operator<CosOp<>, 1, FormulaPromotion::floating>("cos"),
+        formula_operator<TanOp<>, 1, FormulaPromotion::floating>("tan"),
+        formula_operator<AsinOp<>, 1, FormulaPromotion::floating>("asin"),
+        formula_operator<AcosOp<>, 1, FormulaPromotion::floating>("acos"),
+        formula_operator<AtanOp<>, 1, FormulaPromotion::floating>("atan"),
+        formula_operator<SinhOp<>, 1, FormulaPromotion::floating>("sinh"),
+        formula_operator<CoshOp<>, 1, FormulaPromotion::floating>("cosh"),
+        formula_operator<TanhOp<>, 1, FormulaPromotion::floating>("tanh"),
+        formula_operator<AsinhOp<>, 1, FormulaPromotion::floating>("asinh"),
+        formula_operator<AcoshOp<>, 1, FormulaPromotion::floating>("acosh"),
+        formula_operator<AtanhOp<>, 1, FormulaPromotion::floating>("atanh"),
+        formula_operator<AddOp, 2, FormulaPromotion::common>("+"),
+        formula_operator<SubOp, 2, FormulaPromotion::common>("-"),
+        formula_operator<MulOp, 2, FormulaPromotion::common>("*"),
+        formula_operator<DivOp, 2, FormulaPromotion::common>("/"),
+        formula_operator<ModOp, 2, FormulaPromotion::common>("%"),
+        formula_operator<AndOp, 2, FormulaPromotion::common>("&"),
+        formula_operator<OrOp, 2, FormulaPromotion::common>("|"),
+        formula_operator<XorOp, 2, FormulaPromotion::common>("^"),
+        formula_operator<EqOp, 2, FormulaPromotion::common>("=="),
+        formula_operator<NeOp, 2, FormulaPromotion::common>("!="),
+        formula_operator<LtOp, 2, FormulaPromotion::common>("<"),
+        formula_operator<LeOp, 2, FormulaPromotion::common>("<="),
+        formula_operator<GtOp, 2, FormulaPromotion::common>(">"),
+        formula_operator<GeOp, 2, FormulaPromotion::common>(">="),
+        formula_operator<PowOp, 2, FormulaPromotion::common>("pow"),
+        formula_operator<MinOp, 2, FormulaPromotion::common>("min"),
+        formula_operator<MaxOp, 2, FormulaPromotion::common>("max"),
+        formula_operator<SelectOp, 3, FormulaPromotion::select>("where"),
+    };
+
+    /* What a + or - with a product for an operand contracts to, as simplify() does under Rewrite::contract: x * y + z,
+     * x * y - z and z - x * y. They are not callable by name. */
+    inline constexpr std::array formula_contractions{
+        formula_operator<FmaOp, 3, FormulaPromotion::common>("fma"),
+        formula_operator<FmsOp, 3, FormulaPromotion::common>("fms"),
+        formula_operator<FnmaOp, 3, FormulaPromotion::common>("fnma"),
+    };
+
+    /* Binary operator symbols and how tightly they bind, two-character symbols first so that <= is not read as < */
+    inline constexpr std::array<std::pair<std::string_view, int>, 14> formula_symbols{{
+        {"==", 4}, {"!=", 4}, {"<=", 5}, {">=", 5},
+        {"|", 1}, {"^", 2}, {"&", 3}, {"<", 5}, {">", 5}, {"+", 6}, {"-", 6}, {"*", 7}, {"/", 7}, {"%", 7},
+    }};
+
+
+    [[noreturn]] inline void formula_error(const std::string& what, size_t column) {
+        throw std::invalid_argument("Formula: " + what + " at column " + std::to_string(column + 1));
+    }
+
+    /* A node of the parsed formula: a number, a variable, or a call of an operator on its operands */
+    struct FormulaNode {
+        enum class Kind { number, variable, call };
+
+        Kind kind;
+        std::string_view text; /* the variable, or the operator or function called */
+        size_t column;
+        std::vector<FormulaNode> operands;
+        ElementType type{};    /* of a number */
+        std::array<std::byte, formula_lane_bytes> value{};
+    };
+
+    /* Recursive descent over the grammar at the top of this file */
+    class FormulaParser {
+    public:
+        explicit FormulaParser(std::string_view source) : source(source) {}
+
+        [[nodiscard]] FormulaNode parse() {
+            FormulaNode root = binary(1);
+            skip_space();
+            if (pos < source.size()) {
+                formula_error("unexpected '" + std::string(1, source[pos]) + "'", pos);
+            }
+            return root;
+        }
+
+    private:
+        void skip_space() {
+            while (pos < source.size() && std::isspace(static_cast<unsigned char>(source[pos]))) {
+                ++pos;
+            }
+        }
+
+        /* Operands joined by symbols binding at least as tightly as level, left to right */
+        FormulaNode binary(int level) {
+            FormulaNode lhs = unary();
+            for (;;) {
+                skip_space();
+                const auto symbol = std::ranges::find_if(formula_symbols, [&](const auto& entry) {
+                    return source.substr(pos).starts_with(entry.first);
+                });
+                if (symbol == formula_symbols.end() || symbol->second < level) {
+                    return lhs;
+                }
+                const size_t column = pos;
+                pos += symbol->first.size();
+                FormulaNode rhs = binary(symbol->second + 1);
+                lhs = call(symbol->first, column, {std::move(lhs), std::move(rhs)});
+            }
+        }
+
+        FormulaNode unary() {
+            skip_space();
+            const size_t column = pos;
+            if (pos < source.size() && (source[pos] == '-' || source[pos] == '~')) {
+                ++pos;
+                return call(source[column] == '-' ? "neg" : "compl", column, {unary()});
+            }
+            if (pos < source.size() && source[pos] == '+') {
+                ++pos;
+                return unary();
+            }
+            return primary();
+        }
+
+        FormulaNode primary() {
+            const size_t column = pos;
+            if (pos == source.size()) {
+                formula_error("formula ends where an operand was expected", pos);
+            }
+            const char c = source[pos];
+            if (c == '(') {
+                ++pos;
+                FormulaNode inner = binary(1);
+                expect(')');
+                return inner;
+            }
+            if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+                return number();
+            }
+            if (!std::isalpha(static_cast<unsigned char>(c)) && c != '_') {
+                formula_error("unexpected '" + std::string(1, c) + "'", pos);
+            }
+            while (pos < source.size() &&
+                   (std::isalnum(static_cast<unsigned char>(source[pos])) || source[pos] == '_')) {
+                ++pos;
+            }
+            const std::string_view name = source.substr(column, pos - column);
+            skip_space();
+            if (pos == source.size() || source[pos] != '(') {
+                return {FormulaNode::Kind::variable, name, column, {}};
+            }
+            ++pos;
+            std::vector<FormulaNode> operands;
+            skip_space();
+            if (pos < source.size() && source[pos] == ')') {
+                ++pos;
+            } else {
+                operands.push_back(binary(1));
+                skip_space();
+                while (pos < source.size() && source[pos] == ',') {
+                    ++pos;
+                    operands.push_back(binary(1));
+                    skip_space();
+                }
+                expect(')');
+            }
+            return call(name, column, std::move(operands));
+        }
+
+        FormulaNode number() {
+            const size_t column = pos;
+            size_t end = pos;
+            bool real = false;
+            while (end < source.size()) {
+                const char c = source[end];
+                if (std::isdigit(static_cast<unsigned char>(c))) {
+                    ++end;
+                } else if (c == '.' || ((c == 'e' || c == 'E') && end + 1 < source.size())) {
+                    real = true;
+                    end += c != '.' && (source[end + 1] == '+' || source[end + 1] == '-') ? 2 : 1;
+                } else {
+                    break;
+                }
+            }
+            FormulaNode node{FormulaNode::Kind::number, source.substr(column, end - column), column, {}};
+            const char* first = source.data() + column;
+            const char* last = source.data() + end;
+            std::from_chars_result parsed{};
+            if (real && end < source.size() && (source[end] == 'f' || source[end] == 'F')) {
+                float value = 0;
+                parsed = std::from_chars(first, last, value);
+                node.type = ElementType::float32;
+                std::memcpy(node.value.data(), &value, sizeof(value));
+                ++end;
+            } else if (real) {
+                double value = 0;
+                parsed = std::from_chars(first, last, value);
+                node.type = ElementType::float64;
+                std::memcpy(node.value.data(), &value, sizeof(value));
+            } else {
+                int64_t value = 0;
+                parsed = std::from_chars(first, last, value);
+                if (value <= std::numeric_limits<int32_t>::max()) {
+                    const auto narrow = static_cast<int32_t>(value);
+                    node.type = ElementType::int32;
+                    std::memcpy(node.value.data(), &narrow, sizeof(narrow));
+                } else {
+                    node.type = ElementType::int64;
+                    std::memcpy(node.value.data(), &value, sizeof(value));
+                }
+            }
+            if (parsed.ec != std::errc{} || parsed.ptr != last) {
+                formula_error("malformed number '" + std::string(node.text) + "'", column);
+            }
+            pos = end;
+            return node;
+        }
+
+        void expect(char c) {
+            skip_space();
+            if (pos == source.size() || source[pos] != c) {
+                formula_error("expected '" + std::string(1, c) + "'", pos);
+            }
+            ++pos;
+        }
+
+        [[nodiscard]] static FormulaNode call(std::string_view name, size_t column, std::vector<FormulaNode> operands) {
+            return {FormulaNode::Kind::call, name, column, std::move(operands)};
+        }
+
+        std::string_view source;
+        size_t pos = 0;
+    };
+} // namespace detail
+
+
+inline FormulaInput::FormulaInput(std::string_view name, const TensorFile& file)
+    : name(name), type(file.element_type()), shape(file.shape()) {
+    data = detail::visit_element_type(type, [&]<typename T>(std::type_identity<T>) {
+        return static_cast<const void*>(file.view<T>().data());
+    });
+}
+
+
+/* A formula compiled against the element types of its variables, to be evaluated over any tensors of those types.
+ * Variables must all have the same shape; constants are broadcast. */
+class Formula {
+public:
+    /* Throws std::invalid_argument naming the column of the first syntax error, unknown name, operator that does not
+     * apply to the types of its operands, or integer division by a constant zero */
+    Formula(std::string_view source, std::span<const FormulaVariable> variables) {
+        for (const auto& variable : variables) {
+            if (detail::element_info(static_cast<uint8_t>(variable.type)).size == 0) {
+                throw std::invalid_argument("Formula: variable " + std::string(variable.name) +
+                                            " has an unknown element type");
+            }
+            names.emplace_back(variable.name);
+            types.push_back(variable.type);
+            input_slots.push_back(no_slot);
+        }
+        const detail::FormulaNode root = detail::FormulaParser(source).parse();
+        result = compile(root);
+    }
+
+    Formula(std::string_view source, std::initializer_list<FormulaVariable> variables)
+        : Formula(source, std::span<const FormulaVariable>(variables.begin(), variables.size())) {}
+
+    [[nodiscard]] ElementType result_type() const {
+        return slots[result].type;
+    }
+
+    /* Registers a block of elements each; every other operand is a variable or a constant */
+    [[nodiscard]] size_t register_count() const {
+        return registers;
+    }
+
+    /* The bytecode, one instruction per line, as "r1 = * float32 r0, 2" */
+    [[nodiscard]] std::string disassemble() const {
+        std::string listing;
+        for (const auto& instruction : program) {
+            listing += operand(instruction.dst) + " = " + std::string(instruction.name) + " " +
+                       std::string(detail::element_type_name(slots[instruction.dst].type));
+            for (size_t k = 0; k < instruction.arity; ++k) {
+                listing += (k == 0 ? " " : ", ") + operand(instruction.args[k]);
+            }
+            listing += "\n";
+        }
+        listing += "result " + operand(result) + "\n";
+        return listing;
+    }
+
+    /* Evaluates into out, converting the result to T; throws std::invalid_argument if a variable is unbound, bound to
+     * another element type, or bound to a tensor whose shape differs from out's or another variable's */
+    template <detail::numeric T>
+    TensorView<T> evaluate_into(TensorView<T> out, std::span<const FormulaInput> inputs) const {
+        const auto bound = bind(inputs);
+        if (bound.shape && *bound.shape != out.shape()) {
+            throw std::invalid_argument("Formula: cannot evaluate " + bound.shape->to_string() + " into " +
+                                        out.shape().to_string());
+        }
+        run(out.data(), detail::element_type_of<T>(), out.size(), bound.data);
+        return out;
+    }
+
+    template <detail::numeric T>
+    TensorView<T> evaluate_into(TensorView<T> out, std::initializer_list<FormulaInput> inputs) const {
+        return evaluate_into(out, std::span<const FormulaInput>(inputs.begin(), inputs.size()));
+    }
+
+    /* The result as a tensor of T, shaped like the variables; a formula without variables gives one element */
+    template <detail::numeric T>
+    [[nodiscard]] Tensor<T> evaluate(std::span<const FormulaInput> inputs) const {
+        const auto bound = bind(inputs);
+        Tensor<T> out(bound.shape.value_or(Shape(1)));
+        run(out.data(), detail::element_type_of<T>(), out.size(), bound.data);
+        return out;
+    }
+
+    template <detail::numeric T>
+    [[nodiscard]] Tensor<T> evaluate(std::initializer_list<FormulaInput> inputs) const {
+        return evaluate<T>(std::span<const FormulaInput>(inputs.begin(), inputs.size()));
+    }
+
+private:
+    static constexpr size_t no_slot = ~size_t{0};
+
+    /* Where an operand lives: block k of a variable, a constant repeated over a block, a register, or the output */
+    struct Slot {
+        enum class Kind { input, constant, reg, output };
+
+        Kind kind;
+        size_t index; /* variable, constant or register number */
+        ElementType type;
+    };
+
+    struct Instruction {
+        detail::FormulaKernel kernel;
+        std::string_view name;
+        size_t dst;
+        std::array<size_t, 3> args{};
+        size_t arity = 0;
+    };
+
+    struct Constant {
+        ElementType type;
+        std::array<std::byte, detail::formula_lane_bytes> value;
+    };
+
+    struct Binding {
+        std::optional<Shape> shape;
+        std::vector<const std::byte*> data;
+    };
+
+    [[nodiscard]] size_t add_slot(Slot::Kind kind, size_t index, ElementType type) {
+        slots.push_back({kind, index, type});
+        return slots.size() - 1;
+    }
+
+    [[nodiscard]] size_t add_constant(ElementType type,
+                                      const std::array<std::byte, detail::formula_lane_bytes>& value) {
+        constants.push_back({type, value});
+        return add_slot(Slot::Kind::constant, constants.size() - 1, type);
+    }
+
+    [[nodiscard]] size_t allocate(ElementType type) {
+        auto free = std::ranges::find(busy, false);
+        if (free == busy.end()) {
+            busy.push_back(true);
+            registers = busy.size();
+            return add_slot(Slot::Kind::reg, busy.size() - 1, type);
+        }
+        *free = true;
+        return add_slot(Slot::Kind::reg, static_cast<size_t>(free - busy.begin()), type);
+    }
+
+    void release(size_t slot) {
+        if (slots[slot].kind == Slot::Kind::reg) {
+            busy[slots[slot].index] = false;
+        }
+    }
+
+    /* Emits kernel over args into a new register, or runs it once at compile time when every operand is constant */
+    [[nodiscard]] size_t emit(detail::FormulaKernel kernel, std::string_view name, ElementType type,
+                              std::span<const size_t> args) {
+        const bool constant = std::ranges::all_of(args, [&](size_t a) {
+            return slots[a].kind == Slot::Kind::constant;
+        });
+        if (constant) {
+            std::array<const void*, 3> values{};
+            for (size_t k = 0; k < args.size(); ++k) {
+                values[k] = constants[slots[args[k]].index].value.data();
+            }
+            alignas(detail::formula_lane_bytes) std::array<std::byte, detail::formula_lane_bytes> folded{};
+            kernel(folded.data(), values.data(), 1);
+            return add_constant(type, folded);
+        }
+        /* A kernel may write over an operand no narrower than its result, since every packet is read before the
+         * same elements are stored; a wider result would overwrite operand lanes not read yet */
+        const auto size = [](ElementType t) { return detail::element_info(static_cast<uint8_t>(t)).size; };
+        const auto in_place = [&](size_t a) { return size(slots[a].type) >= size(type); };
+        for (size_t a : args) {
+            if (in_place(a)) {
+                release(a);
+            }
+        }
+        Instruction instruction{kernel, name, allocate(type)};
+        for (size_t a : args) {
+            if (!in_place(a)) {
+                release(a);
+            }
+        }
+        std::ranges::copy(args, instruction.args.begin());
+        instruction.arity = args.size();
+        program.push_back(instruction);
+        return instruction.dst;
+    }
+
+    [[nodiscard]] size_t convert(size_t slot, ElementType type) {
+        if (slots[slot].type == type) {
+            return slot;
+        }
+        const size_t args[] = {slot};
+        return emit(detail::conversion_kernel(slots[slot].type, type), "convert", type, args);
+    }
+
+    [[nodiscard]] size_t compile(const detail::FormulaNode& node) {
+        using Kind = detail::FormulaNode::Kind;
+        if (node.kind == Kind::number) {
+            return add_constant(node.type, node.value);
+        }
+        if (node.kind == Kind::variable) {
+            const auto found = std::ranges::find(names, node.text);
+            if (found == names.end()) {
+                detail::formula_error("unknown variable '" + std::string(node.text) + "'", node.column);
+            }
+            const auto v = static_cast<size_t>(found - names.begin());
+            if (input_slots[v] == no_slot) {
+                input_slots[v] = add_slot(Slot::Kind::input, v, types[v]);
+            }
+            return input_slots[v];
+        }
+        if (const auto fused = contract(node)) {
+            return *fused;
+        }
+        std::vector<size_t> args;
+        for (const auto& operand : node.operands) {
+            args.push_back(compile(operand));
+        }
+        for (uint8_t code = 1; code < detail::element_infos.size(); ++code) {
+            if (node.text == detail::element_infos[code].name) {
+                if (args.size() != 1) {
+                    detail::formula_error(std::string(node.text) + "() takes one operand", node.column);
+                }
+                return convert(args[0], static_cast<ElementType>(code));
+            }
+        }
+        const auto op = std::ranges::find_if(detail::formula_operators, [&](const auto& entry) {
+            return entry.name == node.text;
+        });
+        if (op == detail::formula_operators.end()) {
+            detail::formula_error("unknown function '" + std::string(node.text) + "'", node.column);
+        }
+        if (args.size() != op->arity) {
+            detail::formula_error(std::string(node.text) + "() takes " + std::to_string(op->arity) + " operand" +
+                                  (op->arity == 1 ? "" : "s"), node.column);
+        }
+        return apply(*op, args, node.column);
+    }
+
+    /* The type op computes in over the given operands, after promotion */
+    [[nodiscard]] ElementType operand_type(const detail::FormulaOperator& op, std::span<const size_t> args) const {
+        ElementType type = slots[args.back()].type;
+        if (op.promotion == detail::FormulaPromotion::common || op.promotion == detail::FormulaPromotion::select) {
+            const size_t first = op.promotion == detail::FormulaPromotion::select ? 1 : 0;
+            for (size_t k = first; k + 1 < args.size(); ++k) {
+                type = detail::common_element_type(slots[args[k]].type, type);
+            }
+        } else if (op.promotion == detail::FormulaPromotion::floating) {
+            type = detail::visit_element_type(type, []<typename T>(std::type_identity<T>) {
+                return detail::element_type_of<detail::to_floating<T>>();
+            });
+        }
+        return detail::visit_element_type(type, []<typename T>(std::type_identity<T>) {
+            return detail::element_type_of<detail::compute_type<T>>();
+        });
+    }
+
+    [[nodiscard]] size_t apply(const detail::FormulaOperator& op, std::vector<size_t> args, size_t column) {
+        const ElementType type = operand_type(op, args);
+        const auto [kernel, result_type] = op.kernel(type);
+        if (kernel == nullptr) {
+            detail::formula_error(std::string(op.name) + " does not apply to " +
+                                  std::string(detail::element_type_name(type)), column);
+        }
+        for (size_t k = 0; k < args.size(); ++k) {
+            const bool condition = op.promotion == detail::FormulaPromotion::select && k == 0;
+            args[k] = convert(args[k], condition ? ElementType::boolean : type);
+        }
+        /* Integer division by a constant is prepared once, as x / d is in C++, and a zero divisor is an error
+         * before folding could trap on it */
+        if ((op.name == "/" || op.name == "%") && slots[args[1]].kind == Slot::Kind::constant) {
+            if (const auto divide = detail::formula_divisor_kernel_for(type, op.name == "%")) {
+                const auto& divisor = constants[slots[args[1]].index].value;
+                const size_t size = detail::element_info(static_cast<uint8_t>(type)).size;
+                const auto zero = [](std::byte b) { return b == std::byte{}; };
+                if (std::all_of(divisor.begin(), divisor.begin() + size, zero)) {
+                    detail::formula_error("division by zero", column);
+                }
+                return emit(divide, op.name, result_type, args);
+            }
+        }
+        return emit(kernel, op.name, result_type, args);
+    }
+
+    [[nodiscard]] static const detail::FormulaOperator& operator_named(std::string_view name) {
+        return *std::ranges::find(detail::formula_operators, name, &detail::FormulaOperator::name);
+    }
+
+    /* A + or - over a product as one fused multiply-add, when the product is already of the floating type the sum is
+     * computed in; the same condition under which simplify() contracts the template expression */
+    [[nodiscard]] std::optional<size_t> contract(const detail::FormulaNode& node) {
+        using Kind = detail::FormulaNode::Kind;
+        const auto product = [](const detail::FormulaNode& n) {
+            return n.kind == Kind::call && n.text == "*" && n.operands.size() == 2;
+        };
+        if constexpr (!detail::hardware_fma || default_rewrite < Rewrite::contract) {
+            return std::nullopt;
+        }
+        if (node.kind != Kind::call || (node.text != "+" && node.text != "-") || node.operands.size() != 2 ||
+            (!product(node.operands[0]) && !product(node.operands[1]))) {
+            return std::nullopt;
+        }
+        const bool left = product(node.operands[0]);
+        const auto& mul = node.operands[left ? 0 : 1];
+        std::vector<size_t> args(3);
+        if (!left) {
+            args[2] = compile(node.operands[0]);
+        }
+        args[0] = compile(mul.operands[0]);
+        args[1] = compile(mul.operands[1]);
+        if (left) {
+            args[2] = compile(node.operands[1]);
+        }
+        const auto& times = operator_named("*");
+        const ElementType type = times.kernel(operand_type(times, std::span(args).first(2))).result;
+        if ((type == ElementType::float32 || type == ElementType::float64) &&
+            detail::common_element_type(type, slots[args[2]].type) == type) {
+            const auto& fused = detail::formula_contractions[node.text == "+" ? 0 : left ? 1 : 2];
+            return apply(fused, std::move(args), node.column);
+        }
+        const size_t z = args[2];
+        const size_t p = apply(times, {args[0], args[1]}, mul.column);
+        return apply(operator_named(node.text), left ? std::vector{p, z} : std::vector{z, p}, node.column);
+    }
+
+    [[nodiscard]] std::string operand(size_t slot) const {
+        const Slot& s = slots[slot];
+        if (s.kind == Slot::Kind::input) {
+            return names[s.index];
+        }
+        if (s.kind == Slot::Kind::reg) {
+            return "r" + std::to_string(s.index);
+        }
+        if (s.kind == Slot::Kind::output) {
+            return "out";
+        }
+        return detail::visit_element_type(s.type, [&]<typename T>(std::type_identity<T>) {
+            T value;
+            std::memcpy(static_cast<void*>(&value), constants[s.index].value.data(), sizeof(T));
+            if constexpr (detail::integral<T>) {
+                return std::to_string(value);
+            } else {
+                char text[32];
+                std::snprintf(text, sizeof(text), "%g", static_cast<double>(value));
+                return std::string(text);
+            }
+        });
+    }
+
+    /* The data of every variable the formula reads, checked against its declared type and the others' shape */
+    [[nodiscard]] Binding bind(std::span<const FormulaInput> inputs) const {
+        Binding bound;
+        bound.data.resize(names.size());
+        for (size_t v = 0; v < names.size(); ++v) {
+            if (input_slots[v] == no_slot) {
+                continue;
+            }
+            const auto input = std::ranges::find(inputs, std::string_view(names[v]), &FormulaInput::name);
+            if (input == inputs.end()) {
+                throw std::invalid_argument("Formula: variable " + names[v] + " is not bound");
+            }
+            if (input->type != types[v]) {
+                throw std::invalid_argument("Formula: variable " + names[v] + " is " +
+                                            std::string(detail::element_type_name(types[v])) +
+                                            " but is bound to " + std::string(detail::element_type_name(input->type)));
+            }
+            if (bound.shape && *bound.shape != input->shape) {
+                throw std::invalid_argument("Formula: variable " + names[v] + " has shape " + input->shape.to_string() +
+                                            ", the others " + bound.shape->to_string());
+            }
+            bound.shape = input->shape;
+            bound.data[v] = static_cast<const std::byte*>(input->data);
+        }
+        return bound;
+    }
+
+    /* The program with its result written to the output: the last instruction is retargeted when it already produces
+     * the output type, and a conversion is appended otherwise */
+    void run(void* out, ElementType out_type, size_t count, const std::vector<const std::byte*>& data) const {
+        std::vector<Slot> run_slots = slots;
+        std::vector<Instruction> run_program = program;
+        const size_t output = run_slots.size();
+        run_slots.push_back({Slot::Kind::output, 0, out_type});
+        if (!run_program.empty() && run_program.back().dst == result && slots[result].type == out_type) {
+            run_program.back().dst = output;
+        } else {
+            run_program.push_back({detail::conversion_kernel(slots[result].type, out_type),
+                                   "convert", output, {result}, 1});
+        }
+        const auto task = [&](size_t first, size_t last) {
+            constexpr size_t block_bytes = detail::formula_block * detail::formula_lane_bytes;
+            std::vector<uint64_t, AlignedAllocator<uint64_t>> storage((registers + constants.size()) *
+                                                                      detail::formula_block);
+            auto* registers_base = reinterpret_cast<std::byte*>(storage.data());
+            std::byte* constants_base = registers_base + registers * block_bytes;
+            for (size_t c = 0; c < constants.size(); ++c) {
+                const size_t size = detail::element_info(static_cast<uint8_t>(constants[c].type)).size;
+                for (size_t i = 0; i < detail::formula_block; ++i) {
+                    std::memcpy(constants_base + c * block_bytes + i * size, constants[c].value.data(), size);
+                }
+            }
+            std::vector<std::byte*> where(run_slots.size());
+            for (size_t begin = first; begin < last; begin += detail::formula_block) {
+                const size_t n = std::min(detail::formula_block, last - begin);
+                for (size_t s = 0; s < run_slots.size(); ++s) {
+                    const Slot& slot = run_slots[s];
+                    const size_t size = detail::element_info(static_cast<uint8_t>(slot.type)).size;
+                    if (slot.kind == Slot::Kind::input) {
+                        where[s] = const_cast<std::byte*>(data[slot.index]) + begin * size;
+                    } else if (slot.kind == Slot::Kind::constant) {
+                        where[s] = constants_base + slot.index * block_bytes;
+                    } else if (slot.kind == Slot::Kind::reg) {
+                        where[s] = registers_base + slot.index * block_bytes;
+                    } else {
+                        where[s] = static_cast<std::byte*>(out) + begin * size;
+                    }
+                }
+                for (const auto& instruction : run_program) {
+                    std::array<const void*, 3> args{};
+                    for (size_t k = 0; k < instruction.arity; ++k) {
+                        args[k] = where[instruction.args[k]];
+                    }
+                    instruction.kernel(where[instruction.dst], args.data(), n);
+                }
+            }
+        };
+        if (count < parallel_threshold()) {
+            task(0, count);
+        } else {
+            detail::thread_pool().parallel_for(count, 16 * detail::formula_block, task);
+        }
+    }
+
+    std::vector<std::string> names;
+    std::vector<ElementType> types;
+    std::vector<size_t> input_slots;
+    std::vector<Slot> slots;
+    std::vector<Constant> constants;
+    std::vector<Instruction> program;
+    std::vector<bool> busy;
+    size_t registers = 0;
+    size_t result = 0;
+};
@@ -0,0 +1,238 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+
+/* 16-bit floating-point element types. They are storage formats: a value converts to float exactly, arithmetic on
+ * it runs in float, and a float converts back rounding to nearest even. IEEE binary16 keeps 11 significant bits
+ * over a range of +-65504; bfloat16 keeps 8 over the whole range of float. */
+
+namespace detail {
+    /* A double rounded to float with inexact results sent to the neighbour whose last bit is odd. Rounding that to
+     * a format with fewer significant bits then gives the same result as rounding the double directly. */
+    [[nodiscard]] constexpr float round_to_odd(double x) {
+        const float f = static_cast<float>(x);
+        uint32_t bits = std::bit_cast<uint32_t>(f);
+        if (static_cast<double>(f) != x && (bits & 1) == 0 && (bits & 0x7f800000u) != 0x7f800000u) {
+            bits = std::abs(x) > std::abs(static_cast<double>(f)) ? bits + 1 : bits - 1;
+        }
+        return std::bit_cast<float>(bits);
+    }
+
+    /* The same rounding to double, for the 64-bit integers and the long doubles that a double cannot hold exactly:
+     * an integer keeps its top 53 bits with any dropped below them folded into the last, a long double is nudged off
+     * an even neighbour. round_to_odd() of the result is then the value itself rounded to odd at float. */
+    template <typename U>
+    [[nodiscard]] constexpr double round_to_odd_double(U value) {
+        if constexpr (std::is_integral_v<U>) {
+            using Unsigned = std::make_unsigned_t<U>;
+            bool negative = false;
+            if constexpr (std::is_signed_v<U>) {
+                negative = value < 0;
+            }
+            const Unsigned magnitude = negative ? static_cast<Unsigned>(Unsigned{0} - static_cast<Unsigned>(value))
+                                                : static_cast<Unsigned>(value);
+            const int dropped = std::max(static_cast<int>(std::bit_width(magnitude)) - 53, 0);
+            const Unsigned sticky = (magnitude & ((Unsigned{1} << dropped) - 1)) != 0;
+            const double d = static_cast<double>(magnitude >> dropped | sticky) *
+                             static_cast<double>(Unsigned{1} << dropped);
+            return negative ? -d : d;
+        } else {
+            const double d = static_cast<double>(value);
+            uint64_t bits = std::bit_cast<uint64_t>(d);
+            if (static_cast<U>(d) != value && (bits & 1) == 0 && (bits & 0x7ff0000000000000u) != 0x7ff0000000000000u) {
+                bits = std::abs(value) > std::abs(static_cast<U>(d)) ? bits + 1 : bits - 1;
+            }
+            return std::bit_cast<double>(bits);
+        }
+    }
+
+    /* IEEE binary16, after Giesen's branch-light float <-> half conversions */
+    struct Binary16Format {
+        static constexpr int digits = 11;
+        static constexpr int digits10 = 3;
+        static constexpr int max_digits10 = 5;
+        static constexpr int min_exponent = -13;
+        static constexpr int min_exponent10 = -4;
+        static constexpr int max_exponent = 16;
+        static constexpr int max_exponent10 = 4;
+        static constexpr uint16_t min_bits = 0x0400;
+        static constexpr uint16_t max_bits = 0x7bff;
+        static constexpr uint16_t epsilon_bits = 0x1400;
+        static constexpr uint16_t infinity_bits = 0x7c00;
+        static constexpr uint16_t quiet_nan_bits = 0x7e00;
+        static constexpr uint16_t signaling_nan_bits = 0x7d00;
+
+        [[nodiscard]] static constexpr uint16_t encode(float value) {
+            uint32_t f = std::bit_cast<uint32_t>(value);
+            const uint32_t sign = f & 0x80000000u;
+            f ^= sign;
+            uint32_t h;
+            if (f >= 0x47800000u) {
+                /* Overflow and infinity become infinity; NaN becomes the quiet NaN */
+                h = f > 0x7f800000u ? quiet_nan_bits : infinity_bits;
+            } else if (f < 0x38800000u) {
+                /* Adding 0.5 aligns the subnormal significand to the bottom of the float, rounding it there */
+                h = std::bit_cast<uint32_t>(std::bit_cast<float>(f) + 0.5f) - 0x3f000000u;
+            } else {
+                /* Rebias the exponent and round the 13 dropped bits, ties to even */
+                h = (f + 0xc8000fffu + ((f >> 13) & 1)) >> 13;
+            }
+            return static_cast<uint16_t>(h | sign >> 16);
+        }
+
+        [[nodiscard]] static constexpr float decode(uint16_t h) {
+            const uint32_t magnitude = static_cast<uint32_t>(h & 0x7fff) << 13;
+            const uint32_t exponent = magnitude & 0x0f800000u;
+            uint32_t f = magnitude + 0x38000000u;
+            if (exponent == 0x0f800000u) {
+                f += 0x38000000u;
+            } else if (exponent == 0) {
+                /* Subnormal: let the float unit normalize it */
+                f = std::bit_cast<uint32_t>(std::bit_cast<float>(f + 0x00800000u) - std::bit_cast<float>(0x38800000u));
+            }
+            return std::bit_cast<float>(f | static_cast<uint32_t>(h & 0x8000) << 16);
+        }
+    };
+
+    /* The upper half of a float */
+    struct BFloat16Format {
+        static constexpr int digits = 8;
+        static constexpr int digits10 = 2;
+        static constexpr int max_digits10 = 4;
+        static constexpr int min_exponent = -125;
+        static constexpr int min_exponent10 = -37;
+        static constexpr int max_exponent = 128;
+        static constexpr int max_exponent10 = 38;
+        static constexpr uint16_t min_bits = 0x0080;
+        static constexpr uint16_t max_bits = 0x7f7f;
+        static constexpr uint16_t epsilon_bits = 0x3c00;
+        static constexpr uint16_t infinity_bits = 0x7f80;
+        static constexpr uint16_t quiet_nan_bits = 0x7fc0;
+        static constexpr uint16_t signaling_nan_bits = 0x7fa0;
+
+        [[nodiscard]] static constexpr uint16_t encode(float value) {
+            const uint32_t f = std::bit_cast<uint32_t>(value);
+            if ((f & 0x7fffffffu) > 0x7f800000u) {
+                return static_cast<uint16_t>(f >> 16 | 0x0040);
+            }
+            return static_cast<uint16_t>((f + 0x7fffu + ((f >> 16) & 1)) >> 16);
+        }
+
+        [[nodiscard]] static constexpr float decode(uint16_t b) {
+            return std::bit_cast<float>(static_cast<uint32_t>(b) << 16);
+        }
+    };
+
+
+    template <typename Format>
+    class HalfFloat {
+    public:
+        using format = Format;
+
+
+        HalfFloat() = default;
+
+        /* Rounds once to nearest even. Integers wider than 16 bits and doubles go through round_to_odd(), so
+         * that passing through float does not round them twice, and wider integers and long doubles through
+         * round_to_odd_double() before that. */
+        template <typename U>
+        requires std::is_arithmetic_v<U>
+        constexpr HalfFloat(U value) {
+            if constexpr (std::is_same_v<U, float> || (std::is_integral_v<U> && sizeof(U) <= 2)) {
+                bits = Format::encode(static_cast<float>(value));
+            } else if constexpr (std::is_same_v<U, double> || (std::is_integral_v<U> && sizeof(U) <= 4)) {
+                bits = Format::encode(round_to_odd(static_cast<double>(value)));
+            } else {
+                bits = Format::encode(round_to_odd(round_to_odd_double(value)));
+            }
+        }
+
+        template <typename Other>
+        explicit constexpr HalfFloat(HalfFloat<Other> value) : bits(Format::encode(static_cast<float>(value))) {}
+
+        constexpr operator float() const {
+            return Format::decode(bits);
+        }
+
+        [[nodiscard]] static constexpr HalfFloat from_bits(uint16_t raw) {
+            HalfFloat h;
+            h.bits = raw;
+            return h;
+        }
+
+        [[nodiscard]] constexpr uint16_t to_bits() const {
+            return bits;
+        }
+
+    private:
+        uint16_t bits;
+    };
+} // namespace detail
+
+
+using float16 = detail::HalfFloat<detail::Binary16Format>;
+using bfloat16 = detail::HalfFloat<detail::BFloat16Format>;
+
+
+template <typename Format>
+struct std::numeric_limits<detail::HalfFloat<Format>> {
+    using H = detail::HalfFloat<Format>;
+
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool is_exact = false;
+    static constexpr bool has_infinity = true;
+    static constexpr bool has_quiet_NaN = true;
+    static constexpr bool has_signaling_NaN = true;
+    static constexpr bool is_iec559 = std::is_same_v<Format, detail::Binary16Format>;
+    static constexpr bool is_bounded = true;
+    static constexpr bool is_modulo = false;
+    static constexpr bool traps = false;
+    static constexpr bool tinyness_before = false;
+    static constexpr std::float_round_style round_style = std::round_to_nearest;
+    static constexpr int radix = 2;
+    static constexpr int digits = Format::digits;
+    static constexpr int digits10 = Format::digits10;
+    static constexpr int max_digits10 = Format::max_digits10;
+    static constexpr int min_exponent = Format::min_exponent;
+    static constexpr int min_exponent10 = Format::min_exponent10;
+    static constexpr int max_exponent = Format::max_exponent;
+    static constexpr int max_exponent10 = Format::max_exponent10;
+
+    static constexpr H min() noexcept { return H::from_bits(Format::min_bits); }
+    static constexpr H max() noexcept { return H::from_bits(Format::max_bits); }
+    static constexpr H lowest() noexcept { return H::from_bits(Format::max_bits | 0x8000); }
+    static constexpr H epsilon() noexcept { return H::from_bits(Format::epsilon_bits); }
+    static constexpr H round_error() noexcept { return H(0.5f); }
+    static constexpr H infinity() noexcept { return H::from_bits(Format::infinity_bits); }
+    static constexpr H quiet_NaN() noexcept { return H::from_bits(Format::quiet_nan_bits); }
+    static constexpr H signaling_NaN() noexcept { return H::from_bits(Format::signaling_nan_bits); }
+    static constexpr H denorm_min() noexcept { return H::from_bits(1); }
+};
+
+/* Mixed with a built-in type, a 16-bit float behaves as float; the two formats together meet in float as well */
+template <typename Format, typename T>
+requires std::is_arithmetic_v<T>
+struct std::common_type<detail::HalfFloat<Format>, T> {
+    using type = std::common_type_t<float, T>;
+};
+
+template <typename T, typename Format>
+requires std::is_arithmetic_v<T>
+struct std::common_type<T, detail::HalfFloat<Format>> {
+    using type = std::common_type_t<T, float>;
+};
+
+template <typename F, typename G>
+requires (!std::is_same_v<F, G>)
+struct std::common_type<detail::HalfFloat<F>, detail::HalfFloat<G>> {
+    using type = float;
+};
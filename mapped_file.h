@@ -0,0 +1,131 @@
+#pragma once
+
+
+#include <cerrno>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tensor.h"
+
+
+/* A whole file mapped into memory (POSIX). Pages are read in on first touch, so a view over a multi-GB file costs
+ * nothing until it is evaluated; a writable mapping is shared, so stores through it reach the file. */
+class MappedFile {
+public:
+    enum class Mode { read_only, read_write };
+
+
+    /* Throws std::system_error if the file cannot be opened or mapped */
+    explicit MappedFile(const std::string& path, Mode mode = Mode::read_only) : mode(mode) {
+        const bool writable = mode == Mode::read_write;
+        fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "MappedFile: open " + path);
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "MappedFile: stat " + path);
+        }
+        bytes = static_cast<size_t>(info.st_size);
+        if (bytes > 0) {
+            void* addr = ::mmap(nullptr, bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "MappedFile: mmap " + path);
+            }
+            base = static_cast<std::byte*>(addr);
+        }
+    }
+
+    MappedFile(MappedFile&& other) noexcept
+        : base(std::exchange(other.base, nullptr)), bytes(std::exchange(other.bytes, 0)),
+          fd(std::exchange(other.fd, -1)), mode(other.mode) {}
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        std::swap(base, other.base);
+        std::swap(bytes, other.bytes);
+        std::swap(fd, other.fd);
+        std::swap(mode, other.mode);
+        return *this;
+    }
+
+    ~MappedFile() {
+        if (base != nullptr) {
+            ::munmap(base, bytes);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    [[nodiscard]] size_t size() const {
+        return bytes;
+    }
+
+    [[nodiscard]] const std::byte* data() const {
+        return base;
+    }
+
+    [[nodiscard]] bool writable() const {
+        return mode == Mode::read_write;
+    }
+
+    /* Hints the kernel to read ahead aggressively, for files that are scanned front to back */
+    void advise_sequential() const {
+        if (base != nullptr) {
+            ::madvise(base, bytes, MADV_SEQUENTIAL);
+        }
+    }
+
+    /* Elements of T starting offset bytes into the file; count defaults to as many as fit.
+     * Throws std::invalid_argument if the range is out of bounds or misaligned for T. */
+    template <detail::numeric T>
+    [[nodiscard]] TensorView<const T> view(size_t offset = 0, size_t count = npos) const {
+        return {reinterpret_cast<const T*>(locate<T>(offset, count)), count};
+    }
+
+    /* As view(), but writable; throws std::logic_error on a read-only mapping */
+    template <detail::numeric T>
+    [[nodiscard]] TensorView<T> mutable_view(size_t offset = 0, size_t count = npos) {
+        if (!writable()) {
+            throw std::logic_error("MappedFile: mutable_view of a read-only mapping");
+        }
+        return {reinterpret_cast<T*>(locate<T>(offset, count)), count};
+    }
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+private:
+    template <typename T>
+    std::byte* locate(size_t offset, size_t& count) const {
+        if (offset > bytes) {
+            throw std::invalid_argument("MappedFile: offset " + std::to_string(offset) + " past end of file");
+        }
+        if (count == npos) {
+            count = (bytes - offset) / sizeof(T);
+        }
+        if (count > (bytes - offset) / sizeof(T)) {
+            throw std::invalid_argument("MappedFile: " + std::to_string(count) + " elements do not fit in the file");
+        }
+        if (offset % alignof(T) != 0) {
+            throw std::invalid_argument("MappedFile: offset " + std::to_string(offset) + " is misaligned");
+        }
+        return base + offset;
+    }
+
+    std::byte* base = nullptr;
+    size_t bytes = 0;
+    int fd = -1;
+    Mode mode;
+};
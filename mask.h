@@ -0,0 +1,386 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "tensor.h"
+
+
+/* Bit-packed bool tensors. A Mask holds 64 elements to a 64-bit word, an eighth of the memory of a Tensor<bool>.
+ * Comparisons evaluate into it a block at a time without a byte tensor in between, and it reads back into any
+ * expression as bool. Trees of &, |, ^ and ~ over Masks of one shape skip the bytes altogether and run a word at a
+ * time, and count(), any() and all() test whole words. */
+
+namespace detail {
+    inline constexpr size_t mask_word_bits = 64;
+
+    /* Elements evaluated into a byte buffer per step before they are packed into words */
+    inline constexpr size_t mask_block = 8 * mask_word_bits;
+
+    [[nodiscard]] constexpr size_t mask_words(size_t count) {
+        return (count + mask_word_bits - 1) / mask_word_bits;
+    }
+
+    /* The bits of the last word that hold elements; the others are kept clear */
+    [[nodiscard]] constexpr uint64_t mask_tail(size_t count) {
+        const size_t used = count % mask_word_bits;
+        return used == 0 ? ~uint64_t{0} : (uint64_t{1} << used) - 1;
+    }
+
+    /* Expressions that can be evaluated a word at a time: a Mask, or logic over such expressions */
+    template <typename E>
+    inline constexpr bool word_logical = requires (const E& e, size_t w) {
+        { e.word(w) } -> std::same_as<uint64_t>;
+    };
+
+    template <typename E>
+    inline constexpr bool word_logical<UnaryExpr<E, ComplOp>> = word_logical<E>;
+
+    template <typename L, typename R, typename Op>
+    inline constexpr bool word_logical<BinaryExpr<L, R, Op>> =
+        is_any_of_v<Op, AndOp, OrOp, XorOp> && word_logical<L> && word_logical<R>;
+
+    /* Lanes per packet when an expression is packed into bits: the narrowest packet anywhere in its tree, so that a
+     * comparison of floats is evaluated as wide as the floats are rather than as 64 lanes of bool */
+    template <typename E>
+    inline constexpr size_t bits_step = packet_size<typename extract_element_type<E>::type>;
+
+    template <numeric T, typename E>
+    inline constexpr size_t bits_step<CastExpr<T, E>> = std::min(packet_size<T>, bits_step<E>);
+
+    template <typename E, typename Op>
+    inline constexpr size_t bits_step<UnaryExpr<E, Op>> =
+        std::min(packet_size<typename UnaryExpr<E, Op>::element_type>, bits_step<E>);
+
+    template <typename L, typename R, typename Op>
+    inline constexpr size_t bits_step<BinaryExpr<L, R, Op>> =
+        std::min({packet_size<typename BinaryExpr<L, R, Op>::element_type>, bits_step<L>, bits_step<R>});
+
+    template <typename A, typename B, typename C, typename Op>
+    inline constexpr size_t bits_step<TernaryExpr<A, B, C, Op>> =
+        std::min({packet_size<typename TernaryExpr<A, B, C, Op>::element_type>, bits_step<A>, bits_step<B>,
+                  bits_step<C>});
+
+    /* Word w of a word_logical expression; ~ sets the clear bits past the end, which the caller masks off */
+    template <typename E>
+    [[nodiscard]] constexpr uint64_t word_of(const E& expr, size_t w) {
+        if constexpr (requires { expr.word(w); }) {
+            return expr.word(w);
+        } else if constexpr (requires { expr.operand(); }) {
+            return ~word_of(expr.operand(), w);
+        } else {
+            using Op = decltype(expr.operation());
+            const uint64_t x = word_of(expr.left(), w);
+            const uint64_t y = word_of(expr.right(), w);
+            if constexpr (std::is_same_v<Op, AndOp>) {
+                return x & y;
+            } else if constexpr (std::is_same_v<Op, OrOp>) {
+                return x | y;
+            } else {
+                return x ^ y;
+            }
+        }
+    }
+
+    /* Words [first, last) of expr, word w to out[w - first]; element i of expr lands in bit i % 64 of word i / 64.
+     * Whole words are built from packets of bits_step lanes; a partial last word, and rows of a broadcast, go
+     * through a block of bool. */
+    template <typename E>
+    void evaluate_words(uint64_t* out, const E& expr, size_t first, size_t last) {
+        const size_t count = expr.size();
+        if constexpr (word_logical<E>) {
+            if (!expr.broadcasting()) {
+                for (size_t w = first; w < last; ++w) {
+                    out[w - first] = word_of(expr, w);
+                }
+                if (last > first && last == mask_words(count)) {
+                    out[last - 1 - first] &= mask_tail(count);
+                }
+                return;
+            }
+        }
+        const size_t origin = first;
+        if (!expr.broadcasting()) {
+            constexpr size_t N = bits_step<E>;
+            const size_t whole = std::max(first, std::min(last, count / mask_word_bits));
+            for (size_t w = first; w < whole; ++w) {
+                uint64_t bits = 0;
+                for (size_t k = 0; k < mask_word_bits; k += N) {
+                    bits |= bits_of(expr.template packet<N>(w * mask_word_bits + k).template as<bool>()) << k;
+                }
+                out[w - origin] = bits;
+            }
+            first = whole;
+        }
+        alignas(64) bool block[mask_block];
+        for (size_t w = first; w < last; w += mask_block / mask_word_bits) {
+            const size_t begin = w * mask_word_bits;
+            const size_t end = std::min({count, last * mask_word_bits, begin + mask_block});
+            evaluate_window(block, expr, begin, end);
+            std::fill(block + (end - begin), block + mask_words(end - begin) * mask_word_bits, false);
+            for (size_t k = 0; k < end - begin; k += mask_word_bits) {
+                out[w - origin + k / mask_word_bits] = bits_of(Packet<bool, mask_word_bits>::load(block + k));
+            }
+        }
+    }
+
+    template <typename E>
+    void evaluate_words(uint64_t* out, const E& expr) {
+        [[maybe_unused]] const auto probe = profile(EvaluationProfile::Kind::assign, expr, packet_size<bool>,
+                                                    parallel_grain<bool>, 0);
+        const size_t words = mask_words(expr.size());
+        if (expr.size() < parallel_threshold()) {
+            evaluate_words(out, expr, 0, words);
+        } else {
+            thread_pool().parallel_for(words, parallel_grain<bool> / mask_word_bits, [&](size_t first, size_t last) {
+                evaluate_words(out + first, expr, first, last);
+            });
+        }
+    }
+} // namespace detail
+
+
+template <typename Allocator = AlignedAllocator<uint64_t>>
+struct Mask : detail::Expr {
+    using element_type = bool;
+    using allocator_type = Allocator;
+
+
+    explicit Mask(const Shape& shape, bool value = false, const Allocator& alloc = Allocator())
+        : Mask(uninitialized, shape, alloc) {
+        fill(value);
+    }
+
+    Mask(const std::derived_from<Expr> auto& expr, const Allocator& alloc = Allocator())
+        : Mask(uninitialized, expr.shape(), alloc) {
+        detail::evaluate_words(bits, detail::simplify(expr));
+    }
+
+    Mask(const Mask& other)
+        : Mask(uninitialized, other.extents,
+               std::allocator_traits<Allocator>::select_on_container_copy_construction(other.alloc)) {
+        std::copy_n(other.bits, words, bits);
+    }
+
+    Mask(Mask&& other) noexcept
+        : bits(std::exchange(other.bits, nullptr)), words(std::exchange(other.words, 0)),
+          extents(std::exchange(other.extents, Shape(0))), alloc(other.alloc) {}
+
+    ~Mask() {
+        release();
+    }
+
+    Mask& operator=(const Mask& other) {
+        if (this != &other) {
+            resize(other.extents);
+            std::copy_n(other.bits, words, bits);
+        }
+        return *this;
+    }
+
+    Mask& operator=(Mask&& other) noexcept(std::allocator_traits<Allocator>::is_always_equal::value) {
+        if (alloc == other.alloc) {
+            std::swap(bits, other.bits);
+            std::swap(words, other.words);
+            std::swap(extents, other.extents);
+        } else {
+            *this = other;
+        }
+        return *this;
+    }
+
+    Mask& operator=(bool value) {
+        fill(value);
+        return *this;
+    }
+
+    template <std::derived_from<Expr> E>
+    Mask& operator=(const E& expr) {
+        return assign(expr);
+    }
+
+    /* Evaluates into the existing words, going through a temporary only when the shape changes or the expression
+     * reads this mask at positions other than the one being written */
+    template <std::derived_from<Expr> E>
+    Mask& assign(const E& expr) {
+        if (expr.shape() != extents || expr.aliases(detail::Footprint::of(bits, 1, words))) {
+            Mask result(expr, alloc);
+            std::swap(bits, result.bits);
+            std::swap(words, result.words);
+            std::swap(extents, result.extents);
+        } else {
+            detail::evaluate_words(bits, detail::simplify(expr));
+        }
+        return *this;
+    }
+
+    template <typename R>
+    requires requires (const Mask& m, const R& r) { m & r; }
+    Mask& operator&=(const R& rhs) {
+        return assign(*this & rhs);
+    }
+
+    template <typename R>
+    requires requires (const Mask& m, const R& r) { m | r; }
+    Mask& operator|=(const R& rhs) {
+        return assign(*this | rhs);
+    }
+
+    template <typename R>
+    requires requires (const Mask& m, const R& r) { m ^ r; }
+    Mask& operator^=(const R& rhs) {
+        return assign(*this ^ rhs);
+    }
+
+    [[nodiscard]] bool operator[](size_t i) const {
+        return bits[i / detail::mask_word_bits] >> (i % detail::mask_word_bits) & 1;
+    }
+
+    /* The N bits from i on, which straddle two words unless i is aligned to N */
+    template <size_t N>
+    [[nodiscard]] detail::Packet<bool, N> packet(size_t i) const {
+        static_assert(N <= detail::mask_word_bits);
+        const size_t w = i / detail::mask_word_bits;
+        const size_t shift = i % detail::mask_word_bits;
+        uint64_t lanes = bits[w] >> shift;
+        if (shift + N > detail::mask_word_bits) {
+            lanes |= bits[w + 1] << (detail::mask_word_bits - shift);
+        }
+        return detail::from_bits<N>(lanes);
+    }
+
+    /* Elements 64 * w to 64 * w + 63, element 64 * w in bit 0; bits past the last element are zero */
+    [[nodiscard]] uint64_t word(size_t w) const {
+        return bits[w];
+    }
+
+    [[nodiscard]] size_t size() const {
+        return extents.size();
+    }
+
+    [[nodiscard]] const Shape& shape() const {
+        return extents;
+    }
+
+    [[nodiscard]] size_t word_count() const {
+        return words;
+    }
+
+    /* Reinterprets the elements under a new shape of the same size; throws std::invalid_argument otherwise */
+    Mask& reshape(const Shape& shape) {
+        if (shape.size() != extents.size()) {
+            throw std::invalid_argument("Mask: cannot reshape " + extents.to_string() + " to " + shape.to_string());
+        }
+        extents = shape;
+        return *this;
+    }
+
+    [[nodiscard]] constexpr bool broadcasting() const {
+        return false;
+    }
+
+    /* Number of true elements */
+    [[nodiscard]] size_t count() const {
+        size_t total = 0;
+        for (size_t w = 0; w < words; ++w) {
+            total += static_cast<size_t>(std::popcount(bits[w]));
+        }
+        return total;
+    }
+
+    [[nodiscard]] bool any() const {
+        return std::any_of(bits, bits + words, [](uint64_t word) { return word != 0; });
+    }
+
+    [[nodiscard]] bool all() const {
+        if (words == 0) {
+            return true;
+        }
+        return std::all_of(bits, bits + words - 1, [](uint64_t word) { return word == ~uint64_t{0}; }) &&
+               bits[words - 1] == detail::mask_tail(size());
+    }
+
+    [[nodiscard]] uint64_t* data() {
+        return bits;
+    }
+
+    [[nodiscard]] const uint64_t* data() const {
+        return bits;
+    }
+
+    [[nodiscard]] Allocator get_allocator() const {
+        return alloc;
+    }
+
+    [[nodiscard]] constexpr bool aliases(const detail::Footprint& dest) const {
+        return dest.conflicts(bits, 1, words);
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const Mask& m) {
+        os << "Mask(" << m.count() << " of " << m.size() << " set";
+        if (m.size() > 0) {
+            os << ", [";
+            const size_t shown = std::min<size_t>(m.size(), 64);
+            for (size_t i = 0; i < shown; i++) {
+                os << (m[i] ? '1' : '0');
+            }
+            os << (shown < m.size() ? "...]" : "]");
+        }
+        os << ")";
+        return os;
+    }
+
+private:
+    struct uninitialized_t {};
+
+    static constexpr uninitialized_t uninitialized{};
+
+    Mask(uninitialized_t, const Shape& shape, const Allocator& alloc)
+        : words(detail::mask_words(shape.size())), extents(shape), alloc(alloc) {
+        if (words > 0) {
+            bits = std::allocator_traits<Allocator>::allocate(this->alloc, words);
+        }
+    }
+
+    void fill(bool value) {
+        std::fill_n(bits, words, value ? ~uint64_t{0} : 0);
+        if (words > 0) {
+            bits[words - 1] &= detail::mask_tail(size());
+        }
+    }
+
+    void release() {
+        if (bits != nullptr) {
+            std::allocator_traits<Allocator>::deallocate(alloc, bits, words);
+            bits = nullptr;
+        }
+    }
+
+    /* Contents are unspecified afterwards unless the number of words was unchanged */
+    void resize(const Shape& shape) {
+        extents = shape;
+        if (detail::mask_words(shape.size()) != words) {
+            release();
+            words = detail::mask_words(shape.size());
+            if (words > 0) {
+                bits = std::allocator_traits<Allocator>::allocate(alloc, words);
+            }
+        }
+    }
+
+    uint64_t* bits = nullptr;
+    size_t words = 0;
+    Shape extents;
+    [[no_unique_address]] Allocator alloc;
+};
+
+
+template <std::derived_from<detail::Expr> E>
+Mask(E) -> Mask<>;
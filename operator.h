@@ -1,17 +1,40 @@
 #pragma once
 
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
 
 #include "type_helper.h"
+#include "simd.h"
+#include "transcendental.h"
 
 
 namespace detail {
     /* Unary operators */
+    /* On bool a logical not, so that ~mask selects exactly the elements mask does not */
     struct ComplOp {
         template <integral T>
         constexpr T operator()(T x) const {
-            return ~x;
+            if constexpr (std::is_same_v<T, bool>) {
+                return !x;
+            } else {
+                return ~x;
+            }
+        }
+
+        template <integral T, size_t N>
+        constexpr Packet<T, N> operator()(const Packet<T, N>& x) const {
+            if constexpr (std::is_same_v<T, bool>) {
+                return {x.v ^ 1};
+            } else {
+                return (~x.template as<lane_type<T>>()).template as<T>();
+            }
         }
     };
 
@@ -20,6 +43,11 @@ namespace detail {
         constexpr T operator()(T x) const {
             return -x;
         }
+
+        template <numeric T, size_t N>
+        constexpr Packet<T, N> operator()(const Packet<T, N>& x) const {
+            return (-x.template as<lane_type<T>>()).template as<T>();
+        }
     };
 
     struct AbsOp {
@@ -27,6 +55,19 @@ namespace detail {
         constexpr T operator()(T x) const {
             return std::abs(x);
         }
+
+        template <numeric T, size_t N>
+        constexpr Packet<T, N> operator()(const Packet<T, N>& x) const {
+            if constexpr (unsigned_integral<T>) {
+                return x;
+            } else if constexpr (floating<lane_type<T>>) {
+                using V = typename Packet<T, N>::vector_type;
+                using M = typename Packet<T, N>::mask_type;
+                return {(V) ((M) x.v & ~(M) Packet<T, N>::broadcast(-0.0).v)};
+            } else {
+                return select(x < Packet<T, N>{}, -x, x);
+            }
+        }
     };
 
     struct SqrtOp {
@@ -34,114 +75,232 @@ namespace detail {
         constexpr to_floating<T> operator()(T x) const {
             return std::sqrt(static_cast<to_floating<T>>(x));
         }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return packet_map(*this, x);
+        }
     };
 
+    template <Accuracy A = default_accuracy>
     struct ExpOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::exp(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return exp_kernel(v); },
+                                     [](const auto& v) { return exp_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct LogOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::log(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return log_kernel(v); },
+                                     [](const auto& v) { return log_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct Log10Op {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::log10(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return log10_kernel(v); },
+                                     [](const auto& v) { return log10_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct SinOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::sin(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return sin_kernel(v); },
+                                     [](const auto& v) { return sin_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct CosOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::cos(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return cos_kernel(v); },
+                                     [](const auto& v) { return cos_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct TanOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::tan(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return tan_kernel(v); },
+                                     [](const auto& v) { return tan_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct AsinOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::asin(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return asin_kernel(v); },
+                                     [](const auto& v) { return asin_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct AcosOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::acos(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return acos_kernel(v); },
+                                     [](const auto& v) { return acos_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct AtanOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::atan(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return atan_kernel(v); },
+                                     [](const auto& v) { return atan_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct SinhOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::sinh(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return sinh_kernel(v); },
+                                     [](const auto& v) { return sinh_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct CoshOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::cosh(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return cosh_kernel(v); },
+                                     [](const auto& v) { return cosh_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct TanhOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::tanh(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return tanh_kernel(v); },
+                                     [](const auto& v) { return tanh_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct AsinhOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::asinh(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return asinh_kernel(v); },
+                                     [](const auto& v) { return asinh_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct AcoshOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::acosh(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return acosh_kernel(v); },
+                                     [](const auto& v) { return acosh_precise(v); });
         }
     };
 
+    template <Accuracy A = default_accuracy>
     struct AtanhOp {
         template <numeric T>
         constexpr to_floating<T> operator()(T x) const {
-            return std::atanh(static_cast<to_floating<T>>(x));
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t N>
+        constexpr Packet<to_floating<T>, N> operator()(const Packet<T, N>& x) const {
+            return transcendental<A>(x.template as<to_floating<T>>(), [](const auto& v) { return atanh_kernel(v); },
+                                     [](const auto& v) { return atanh_precise(v); });
         }
     };
 
 
+    /* Ops that exist in one instantiation per Accuracy tier, matched whatever the tier */
+    template <typename Op, template <Accuracy> typename Family>
+    inline constexpr bool is_tier_of = false;
+
+    template <Accuracy A, template <Accuracy> typename Family>
+    inline constexpr bool is_tier_of<Family<A>, Family> = true;
+
+
     /* Binary operators */
     /* Bitwise operators */
     struct AndOp {
@@ -149,6 +308,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x & y;
         }
+
+        template <integral L, integral R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = lane_type<std::common_type_t<L, R>>;
+            return (x.template as<W>() & y.template as<W>()).template as<bool>();
+        }
     };
 
     struct OrOp {
@@ -156,6 +321,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x | y;
         }
+
+        template <integral L, integral R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = lane_type<std::common_type_t<L, R>>;
+            return (x.template as<W>() | y.template as<W>()).template as<bool>();
+        }
     };
 
     struct XorOp {
@@ -163,6 +334,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x ^ y;
         }
+
+        template <integral L, integral R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = lane_type<std::common_type_t<L, R>>;
+            return (x.template as<W>() ^ y.template as<W>()).template as<bool>();
+        }
     };
 
     /* Comparison operators */
@@ -171,6 +348,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x == y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = std::common_type_t<L, R>;
+            return x.template as<W>() == y.template as<W>();
+        }
     };
 
     struct NeOp {
@@ -178,6 +361,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x != y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = std::common_type_t<L, R>;
+            return x.template as<W>() != y.template as<W>();
+        }
     };
 
     struct LtOp {
@@ -185,6 +374,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x < y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = std::common_type_t<L, R>;
+            return x.template as<W>() < y.template as<W>();
+        }
     };
 
     struct LeOp {
@@ -192,6 +387,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x <= y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = std::common_type_t<L, R>;
+            return x.template as<W>() <= y.template as<W>();
+        }
     };
 
     struct GtOp {
@@ -199,6 +400,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x > y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = std::common_type_t<L, R>;
+            return x.template as<W>() > y.template as<W>();
+        }
     };
 
     struct GeOp {
@@ -206,6 +413,12 @@ namespace detail {
         constexpr bool operator()(L x, R y) const {
             return x >= y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<bool, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = std::common_type_t<L, R>;
+            return x.template as<W>() >= y.template as<W>();
+        }
     };
 
     /* Arithmetic operators */
@@ -214,6 +427,12 @@ namespace detail {
         constexpr common_type_t<L, R> operator()(L x, R y) const {
             return x + y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<common_type_t<L, R>, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = lane_type<common_type_t<L, R>>;
+            return (x.template as<W>() + y.template as<W>()).template as<common_type_t<L, R>>();
+        }
     };
 
     struct SubOp {
@@ -221,6 +440,12 @@ namespace detail {
         constexpr common_type_t<L, R> operator()(L x, R y) const {
             return x - y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<common_type_t<L, R>, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = lane_type<common_type_t<L, R>>;
+            return (x.template as<W>() - y.template as<W>()).template as<common_type_t<L, R>>();
+        }
     };
 
     struct MulOp {
@@ -228,6 +453,12 @@ namespace detail {
         constexpr common_type_t<L, R> operator()(L x, R y) const {
             return x * y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<common_type_t<L, R>, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = lane_type<common_type_t<L, R>>;
+            return (x.template as<W>() * y.template as<W>()).template as<common_type_t<L, R>>();
+        }
     };
 
     struct DivOp {
@@ -235,6 +466,13 @@ namespace detail {
         constexpr common_type_t<L, R> operator()(L x, R y) const {
             return x / y;
         }
+
+        /* Integers are divided in their promoted type, as the scalar overload does */
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<common_type_t<L, R>, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = decltype(L{} / R{});
+            return (x.template as<W>() / y.template as<W>()).template as<common_type_t<L, R>>();
+        }
     };
 
     struct ModOp {
@@ -242,8 +480,247 @@ namespace detail {
         constexpr common_type_t<L, R> operator()(L x, R y) const {
             return x % y;
         }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<common_type_t<L, R>, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using W = decltype(L{} % R{});
+            return (x.template as<W>() % y.template as<W>()).template as<common_type_t<L, R>>();
+        }
+    };
+
+
+    /* Division of W-bit integers by a divisor fixed in advance, as a high multiply, an add and shifts
+     * (Granlund and Montgomery, "Division by invariant integers using multiplication", figures 4.1 and 5.2) */
+    template <integral W>
+    class InvariantDivisor {
+        using U = std::make_unsigned_t<W>;
+        using UWide = std::conditional_t<sizeof(W) == 2, uint32_t,
+                      std::conditional_t<sizeof(W) == 4, uint64_t, unsigned __int128>>;
+        using Wide = std::conditional_t<std::is_signed_v<W>,
+                     std::conditional_t<sizeof(W) == 2, int32_t, std::conditional_t<sizeof(W) == 4, int64_t, __int128>>,
+                     UWide>;
+        static constexpr int bits = std::numeric_limits<U>::digits;
+
+    public:
+        constexpr InvariantDivisor() = default;
+
+        /* Throws std::domain_error for a zero divisor */
+        explicit constexpr InvariantDivisor(W divisor) : d(divisor) {
+            if (divisor == 0) {
+                throw std::domain_error("division by zero");
+            }
+            if constexpr (std::is_unsigned_v<W>) {
+                /* l = ceil(log2 d), m = floor(2^W * (2^l - d) / d) + 1 */
+                const int l = std::bit_width(static_cast<U>(divisor - 1));
+                magic = static_cast<U>((((UWide{1} << l) - divisor) << bits) / divisor + 1);
+                shift1 = std::min(l, 1);
+                shift2 = std::max(l - 1, 0);
+            } else {
+                /* l = max(ceil(log2 |d|), 1), m = floor(2^(W + l - 1) / |d|) + 1 - 2^W */
+                const U bits_of_divisor = static_cast<U>(divisor);
+                const U magnitude = divisor < 0 ? static_cast<U>(U{0} - bits_of_divisor) : bits_of_divisor;
+                const int l = std::max(static_cast<int>(std::bit_width(static_cast<U>(magnitude - 1))), 1);
+                magic = static_cast<U>((UWide{1} << (bits + l - 1)) / magnitude + 1);
+                shift1 = l - 1;
+                sign = divisor < 0 ? static_cast<U>(~U{0}) : U{0};
+            }
+        }
+
+        [[nodiscard]] constexpr W divide(W n) const {
+            const U x = static_cast<U>(n);
+            const auto product = static_cast<Wide>(n) * static_cast<Wide>(static_cast<W>(magic));
+            const U high = static_cast<U>(static_cast<UWide>(product) >> bits);
+            if constexpr (std::is_unsigned_v<W>) {
+                return static_cast<W>((high + static_cast<U>(static_cast<U>(x - high) >> shift1)) >> shift2);
+            } else {
+                const U q = static_cast<U>(static_cast<U>(static_cast<W>(static_cast<U>(x + high)) >> shift1) -
+                                           static_cast<U>(n >> (bits - 1)));
+                return static_cast<W>(static_cast<U>((q ^ sign) - sign));
+            }
+        }
+
+        [[nodiscard]] constexpr W remainder(W n) const {
+            return static_cast<W>(static_cast<U>(static_cast<U>(n) - static_cast<U>(divide(n)) * static_cast<U>(d)));
+        }
+
+        /* 64-bit lanes are split into 32-bit products, which only pays off with 256-bit registers or wider */
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<W, N> divide(const Packet<W, N>& n) const {
+            using V = typename Packet<W, N>::vector_type;
+            using UV = typename Packet<U, N>::vector_type;
+            const UV x = (UV) n.v;
+            if constexpr (sizeof(W) == 8 && simd_width < 32) {
+                return packet_map([this](W y) { return divide(y); }, n);
+            } else if constexpr (std::is_unsigned_v<W>) {
+                const UV high = high_product(x);
+                return {(high + ((x - high) >> shift1)) >> shift2};
+            } else {
+                const UV high = high_product(x);
+                const UV q = (UV) ((V) (x + high) >> shift1) - (UV) (n.v >> (bits - 1));
+                return {(V) ((q ^ sign) - sign)};
+            }
+        }
+
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<W, N> remainder(const Packet<W, N>& n) const {
+            using V = typename Packet<W, N>::vector_type;
+            using UV = typename Packet<U, N>::vector_type;
+            return {(V) ((UV) n.v - (UV) divide(n).v * static_cast<U>(d))};
+        }
+
+    private:
+        /* Upper half of x * magic in every lane, signed if W is. Only unsigned multiplies are used, since most
+         * targets have a widening one for unsigned lanes alone: 16- and 32-bit lanes widen, 64-bit lanes are split
+         * into 32-bit halves. A signed product is the unsigned one less each operand where the other is negative. */
+        template <typename UV>
+        [[nodiscard]] constexpr UV high_product(const UV& x) const {
+            UV high;
+            if constexpr (sizeof(W) == 8) {
+                constexpr U low = 0xFFFFFFFF;
+                const UV xl = x & low;
+                const UV xh = x >> 32;
+                const UV ll = xl * (magic & low);
+                const UV hl = xh * (magic & low);
+                const UV lh = xl * (magic >> 32);
+                const UV cross = (ll >> 32) + (hl & low) + lh;
+                high = xh * (magic >> 32) + (hl >> 32) + (cross >> 32);
+            } else {
+                constexpr size_t N = sizeof(UV) / sizeof(U);
+                using WV = typename Packet<UWide, N>::vector_type;
+                high = __builtin_convertvector(__builtin_convertvector(x, WV) * static_cast<UWide>(magic) >> bits, UV);
+            }
+            if constexpr (std::is_signed_v<W>) {
+                using V = typename Packet<W, sizeof(UV) / sizeof(U)>::vector_type;
+                high -= (UV) ((V) x >> (bits - 1)) & magic;
+                if (static_cast<W>(magic) < 0) {
+                    high -= x;
+                }
+            }
+            return high;
+        }
+
+        W d = 1;
+        U magic = 0;
+        U sign = 0;
+        int shift1 = 0;
+        int shift2 = 0;
     };
 
+    /* x / d and x % d for one integral divisor shared by every element, prepared once when the expression is built.
+     * Integers narrower than int are divided in int, as x / y promotes them; their packets use 16-bit lanes whenever
+     * that gives the same quotients, which is for every divisor that fits except -1. */
+    template <integral L, integral R>
+    class ScalarDivision {
+        using W = decltype(L{} / R{});
+        using S = std::conditional_t<signed_integral<L>, int16_t, uint16_t>;
+        static constexpr bool narrow = sizeof(L) <= 2 && std::is_same_v<W, int>;
+
+    public:
+        using result_type = common_type_t<L, R>;
+
+
+        constexpr ScalarDivision() = default;
+
+        /* Throws std::domain_error for a zero divisor */
+        explicit constexpr ScalarDivision(R divisor) : value(divisor), wide(static_cast<W>(divisor)) {
+            if constexpr (narrow) {
+                const W d = static_cast<W>(divisor);
+                if (std::in_range<S>(d) && d != -1) {
+                    shortened = true;
+                    lanes = InvariantDivisor<S>(static_cast<S>(d));
+                }
+            }
+        }
+
+        [[nodiscard]] constexpr result_type quotient(L x) const {
+            return static_cast<result_type>(wide.divide(static_cast<W>(x)));
+        }
+
+        [[nodiscard]] constexpr result_type remainder(L x) const {
+            return static_cast<result_type>(wide.remainder(static_cast<W>(x)));
+        }
+
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<result_type, N> quotient(const Packet<L, N>& x) const {
+            if constexpr (narrow) {
+                if (shortened) {
+                    return lanes.divide(x.template as<S>()).template as<result_type>();
+                }
+            }
+            return wide.divide(x.template as<W>()).template as<result_type>();
+        }
+
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<result_type, N> remainder(const Packet<L, N>& x) const {
+            if constexpr (narrow) {
+                if (shortened) {
+                    return lanes.remainder(x.template as<S>()).template as<result_type>();
+                }
+            }
+            return wide.remainder(x.template as<W>()).template as<result_type>();
+        }
+
+        [[nodiscard]] constexpr R divisor() const {
+            return value;
+        }
+
+    private:
+        R value{};
+        InvariantDivisor<W> wide;
+        InvariantDivisor<S> lanes;
+        bool shortened = false;
+    };
+
+    template <integral L, integral R>
+    struct ScalarDivOp : ScalarDivision<L, R> {
+        using ScalarDivision<L, R>::ScalarDivision;
+
+        constexpr auto operator()(L x) const {
+            return this->quotient(x);
+        }
+
+        template <size_t N>
+        constexpr auto operator()(const Packet<L, N>& x) const {
+            return this->quotient(x);
+        }
+    };
+
+    template <integral L, integral R>
+    struct ScalarModOp : ScalarDivision<L, R> {
+        using ScalarDivision<L, R>::ScalarDivision;
+
+        constexpr auto operator()(L x) const {
+            return this->remainder(x);
+        }
+
+        template <size_t N>
+        constexpr auto operator()(const Packet<L, N>& x) const {
+            return this->remainder(x);
+        }
+    };
+
+
+    /* Products that stay in the operand type, wrapping for integers like x * x does */
+    template <typename T>
+    [[nodiscard]] constexpr T times(const T& x, const T& y) {
+        return static_cast<T>(x * y);
+    }
+
+    /* result * base^exp by repeated squaring; exp is the same for every lane, so a packet runs one uniform loop */
+    template <typename T>
+    [[nodiscard]] constexpr T multiply_chain(T base, uint64_t exp, T result) {
+        while (exp != 0) {
+            if (exp & 1) {
+                result = times(result, base);
+            }
+            exp >>= 1;
+            if (exp != 0) {
+                base = times(base, base);
+            }
+        }
+        return result;
+    }
+
     struct PowOp {
         template <floating B, floating E>
         constexpr auto operator()(B base, E exp) const {
@@ -251,24 +728,263 @@ namespace detail {
             return std::pow(static_cast<T>(base), static_cast<T>(exp));
         }
 
+        template <floating B, integral E>
+        constexpr B operator()(B base, E exp) const {
+            return static_cast<B>(std::pow(static_cast<double>(base), static_cast<double>(exp)));
+        }
+
         template <integral B, unsigned_integral E>
         constexpr auto operator()(B base, E exp) const {
             using T = std::common_type_t<B, E>;
-            return fast_pow(static_cast<T>(base), static_cast<T>(exp));
+            return multiply_chain(static_cast<T>(base), static_cast<uint64_t>(exp), T{1});
         }
 
-    private:
-        template <integral T>
-        T fast_pow(T base, T exp) {
-            T result = 1;
-            while (exp != 0) {
-                if (exp & 1) {
-                    result *= base;
+        template <numeric B, numeric E>
+        requires half_floating<B> || half_floating<E>
+        constexpr auto operator()(B base, E exp) const {
+            return (*this)(static_cast<compute_type<B>>(base), static_cast<compute_type<E>>(exp));
+        }
+
+        template <numeric B, numeric E, size_t N>
+        constexpr auto operator()(const Packet<B, N>& base, const Packet<E, N>& exp) const {
+            return packet_map(*this, base, exp);
+        }
+    };
+
+
+    /* Multiplications in the chain static_power() builds for x^n, n <= max_static_chain: either one more factor of
+     * x on top of x^(n-1), or x^d raised to n / d. Squaring is the d = 2 split; the odd splits beat plain binary
+     * powering for n = 15, 27, 33, ... */
+    inline constexpr unsigned max_static_chain = 256;
+
+    inline constexpr auto chain_cost = [] {
+        std::array<unsigned, max_static_chain + 1> cost{};
+        for (unsigned n = 2; n <= max_static_chain; ++n) {
+            cost[n] = cost[n - 1] + 1;
+            for (unsigned d = 2; d * d <= n; ++d) {
+                if (n % d == 0) {
+                    cost[n] = std::min(cost[n], cost[d] + cost[n / d]);
+                }
+            }
+        }
+        return cost;
+    }();
+
+    [[nodiscard]] consteval unsigned chain_split(unsigned n) {
+        for (unsigned d = 2; d * d <= n; ++d) {
+            if (n % d == 0 && chain_cost[d] + chain_cost[n / d] == chain_cost[n]) {
+                return d;
+            }
+        }
+        return 1;
+    }
+
+    template <unsigned N, typename T>
+    [[nodiscard]] constexpr T static_power(const T& x) {
+        if constexpr (N == 1) {
+            return x;
+        } else if constexpr (N > max_static_chain) {
+            const T half = static_power<N / 2>(x);
+            return N % 2 == 0 ? times(half, half) : times(times(half, half), x);
+        } else if constexpr (constexpr unsigned d = chain_split(N); d > 1) {
+            return static_power<N / d>(static_power<d>(x));
+        } else {
+            return times(static_power<N - 1>(x), x);
+        }
+    }
+
+    /* x^N for an exponent known at compile time; negative N only for floating-point x */
+    template <int N>
+    struct ConstPowOp {
+        template <numeric T>
+        constexpr compute_type<T> operator()(T x) const {
+            return (*this)(Packet<T, 1>::broadcast(x))[0];
+        }
+
+        template <numeric T, size_t M>
+        constexpr Packet<compute_type<T>, M> operator()(const Packet<T, M>& x) const {
+            using C = compute_type<T>;
+            static_assert(N >= 0 || floating<C>, "pow<N>: negative exponent of an integral type");
+            const auto one = Packet<C, M>::broadcast(1);
+            if constexpr (N == 0) {
+                return one;
+            } else if constexpr (N > 0) {
+                return static_power<static_cast<unsigned>(N)>(x.template as<C>());
+            } else {
+                return one / static_power<-static_cast<unsigned>(N)>(x.template as<C>());
+            }
+        }
+    };
+
+    /* x^e for one runtime exponent shared by every element, classified once when the expression is built:
+     * small integral values run a multiply chain (a reciprocal for negative ones), 0.5 is a square root, and
+     * anything else calls std::pow lane by lane */
+    template <numeric E>
+    struct ScalarPowOp {
+        /* Past this, a chain of squarings loses more accuracy than std::pow */
+        static constexpr uint64_t max_chain = 64;
+
+
+        constexpr ScalarPowOp() = default;
+
+        explicit constexpr ScalarPowOp(E exponent) : exponent(exponent) {
+            if constexpr (integral<E>) {
+                const auto bits = static_cast<uint64_t>(exponent);
+                magnitude = exponent < 0 ? uint64_t{0} - bits : bits;
+                negative = exponent < 0;
+                kind = Kind::integer;
+            } else if (exponent == E(0.5)) {
+                kind = Kind::sqrt;
+            } else if (std::trunc(exponent) == exponent && std::abs(exponent) <= max_chain) {
+                magnitude = static_cast<uint64_t>(std::abs(exponent));
+                negative = exponent < 0;
+                kind = Kind::integer;
+            }
+        }
+
+        template <numeric B>
+        requires floating<compute_type<B>> || integral<E>
+        constexpr auto operator()(B base) const {
+            return (*this)(Packet<B, 1>::broadcast(base))[0];
+        }
+
+        template <numeric B, size_t N>
+        requires floating<compute_type<B>> || integral<E>
+        constexpr auto operator()(const Packet<B, N>& base) const {
+            using C = compute_type<B>;
+            using R = std::conditional_t<floating<C> && floating<E>, common_type_t<C, E>, C>;
+            const Packet<R, N> x = base.template as<R>();
+            const auto one = Packet<R, N>::broadcast(1);
+            if constexpr (floating<R>) {
+                if (kind == Kind::integer && (!integral<E> || magnitude <= max_chain)) {
+                    const Packet<R, N> power = multiply_chain(x, magnitude, one);
+                    return negative ? one / power : power;
+                } else if (kind == Kind::sqrt) {
+                    /* pow(-0, 0.5) is +0 and pow(-inf, 0.5) is +inf, where sqrt gives -0 and NaN */
+                    const auto inf = Packet<R, N>::broadcast(std::numeric_limits<R>::infinity());
+                    return select(x == -inf, inf, SqrtOp{}(x + Packet<R, N>{}));
+                } else {
+                    return packet_map([this](R y) { return static_cast<R>(std::pow(y, static_cast<R>(exponent))); }, x);
                 }
-                base *= base;
-                exp >>= 1;
+            } else {
+                if (negative) {
+                    throw std::domain_error("pow: negative exponent of an integral type");
+                }
+                return multiply_chain(x, magnitude, one);
             }
-            return result;
+        }
+
+        [[nodiscard]] constexpr E value() const {
+            return exponent;
+        }
+
+    private:
+        enum class Kind { general, integer, sqrt };
+
+        E exponent{};
+        uint64_t magnitude = 0;
+        bool negative = false;
+        Kind kind = Kind::general;
+    };
+
+    /* Selection operators */
+    struct MinOp {
+        template <numeric L, numeric R>
+        constexpr common_type_t<L, R> operator()(L x, R y) const {
+            using T = common_type_t<L, R>;
+            return static_cast<T>(y) < static_cast<T>(x) ? static_cast<T>(y) : static_cast<T>(x);
+        }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<common_type_t<L, R>, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using T = common_type_t<L, R>;
+            const auto xx = x.template as<T>();
+            const auto yy = y.template as<T>();
+            return {yy.v < xx.v ? yy.v : xx.v};
+        }
+    };
+
+    struct MaxOp {
+        template <numeric L, numeric R>
+        constexpr common_type_t<L, R> operator()(L x, R y) const {
+            using T = common_type_t<L, R>;
+            return static_cast<T>(x) < static_cast<T>(y) ? static_cast<T>(y) : static_cast<T>(x);
+        }
+
+        template <numeric L, numeric R, size_t N>
+        constexpr Packet<common_type_t<L, R>, N> operator()(const Packet<L, N>& x, const Packet<R, N>& y) const {
+            using T = common_type_t<L, R>;
+            const auto xx = x.template as<T>();
+            const auto yy = y.template as<T>();
+            return {xx.v < yy.v ? yy.v : xx.v};
+        }
+    };
+
+    /* cond ? x : y, as a blend of both operands; any nonzero condition selects x */
+    struct SelectOp {
+        template <numeric C, numeric A, numeric B>
+        constexpr common_type_t<A, B> operator()(C cond, A x, B y) const {
+            using T = common_type_t<A, B>;
+            return cond ? static_cast<T>(x) : static_cast<T>(y);
+        }
+
+        template <numeric C, numeric A, numeric B, size_t N>
+        constexpr Packet<common_type_t<A, B>, N> operator()(const Packet<C, N>& cond, const Packet<A, N>& x,
+                                                           const Packet<B, N>& y) const {
+            using T = common_type_t<A, B>;
+            return select(cond.template as<bool>(), x.template as<T>(), y.template as<T>());
+        }
+    };
+
+
+    /* Fused operators, formed by simplify() from a multiply feeding an add or subtract; one rounding instead of two */
+    template <numeric A, numeric B, numeric C>
+    using fused_type = common_type_t<common_type_t<A, B>, C>;
+
+    struct FmaOp {
+        template <numeric A, numeric B, numeric C>
+        constexpr fused_type<A, B, C> operator()(A x, B y, C z) const {
+            using T = fused_type<A, B, C>;
+            return std::fma(static_cast<T>(x), static_cast<T>(y), static_cast<T>(z));
+        }
+
+        template <numeric A, numeric B, numeric C, size_t N>
+        constexpr Packet<fused_type<A, B, C>, N> operator()(const Packet<A, N>& x, const Packet<B, N>& y,
+                                                           const Packet<C, N>& z) const {
+            using T = fused_type<A, B, C>;
+            return fma(x.template as<T>(), y.template as<T>(), z.template as<T>());
+        }
+    };
+
+    /* x * y - z */
+    struct FmsOp {
+        template <numeric A, numeric B, numeric C>
+        constexpr fused_type<A, B, C> operator()(A x, B y, C z) const {
+            using T = fused_type<A, B, C>;
+            return std::fma(static_cast<T>(x), static_cast<T>(y), -static_cast<T>(z));
+        }
+
+        template <numeric A, numeric B, numeric C, size_t N>
+        constexpr Packet<fused_type<A, B, C>, N> operator()(const Packet<A, N>& x, const Packet<B, N>& y,
+                                                           const Packet<C, N>& z) const {
+            using T = fused_type<A, B, C>;
+            return fma(x.template as<T>(), y.template as<T>(), -z.template as<T>());
+        }
+    };
+
+    /* z - x * y */
+    struct FnmaOp {
+        template <numeric A, numeric B, numeric C>
+        constexpr fused_type<A, B, C> operator()(A x, B y, C z) const {
+            using T = fused_type<A, B, C>;
+            return std::fma(-static_cast<T>(x), static_cast<T>(y), static_cast<T>(z));
+        }
+
+        template <numeric A, numeric B, numeric C, size_t N>
+        constexpr Packet<fused_type<A, B, C>, N> operator()(const Packet<A, N>& x, const Packet<B, N>& y,
+                                                           const Packet<C, N>& z) const {
+            using T = fused_type<A, B, C>;
+            return fma(-x.template as<T>(), y.template as<T>(), z.template as<T>());
         }
     };
 } // namespace detail
@@ -0,0 +1,194 @@
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace detail {
+    /* Fixed set of workers that split [0, count) into grains; the calling thread takes grains too */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(size_t threads) {
+            for (size_t i = 1; i < threads; ++i) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return workers.size() + 1;
+        }
+
+        template <typename F>
+        void parallel_for(size_t count, size_t grain, F&& body) {
+            const size_t grains = (count + grain - 1) / grain;
+            /* Nested calls, and calls racing another evaluation, run on the calling thread */
+            std::unique_lock submitting(submit, std::try_to_lock);
+            if (workers.empty() || grains <= 1 || in_parallel || !submitting) {
+                body(size_t{0}, count);
+                return;
+            }
+
+            Job job{[&](size_t g) { body(g * grain, std::min(g * grain + grain, count)); }, grains};
+            {
+                std::lock_guard lock(mutex);
+                current = &job;
+                ++generation;
+            }
+            {
+                const Retire retire{*this};
+                wake.notify_all();
+                job.run();
+            }
+            if (job.failure) {
+                std::rethrow_exception(job.failure);
+            }
+        }
+
+    private:
+        /* Marks the thread as running grains, so that a parallel_for inside one runs on that thread */
+        struct InParallel {
+            bool outer = std::exchange(in_parallel, true);
+
+            ~InParallel() {
+                in_parallel = outer;
+            }
+        };
+
+        struct Job {
+            std::function<void(size_t)> task;
+            size_t grains;
+            std::atomic<size_t> next = 0;
+            std::atomic<bool> failed = false;
+            std::exception_ptr failure{};
+
+            /* Takes grains until none are left. The first exception is kept for the caller to rethrow, and no grain
+             * is handed out after it. */
+            void run() {
+                const InParallel scope;
+                try {
+                    for (size_t g = next++; g < grains; g = next++) {
+                        task(g);
+                    }
+                } catch (...) {
+                    next = grains;
+                    if (!failed.exchange(true)) {
+                        failure = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        /* Waits for every worker to leave the current job, however the caller leaves it, before the job goes away */
+        struct Retire {
+            ThreadPool& pool;
+
+            ~Retire() {
+                std::unique_lock lock(pool.mutex);
+                pool.idle.wait(lock, [this] { return pool.active == 0; });
+                pool.current = nullptr;
+            }
+        };
+
+        void work() {
+            size_t seen = 0;
+            std::unique_lock lock(mutex);
+            while (true) {
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+                Job* job = current;
+                if (job == nullptr) {
+                    continue;
+                }
+                ++active;
+                lock.unlock();
+                job->run();
+                lock.lock();
+                if (--active == 0) {
+                    idle.notify_all();
+                }
+            }
+        }
+
+        static inline thread_local bool in_parallel = false;
+
+        std::mutex submit;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable idle;
+        Job* current = nullptr;
+        size_t generation = 0;
+        size_t active = 0;
+        bool stopping = false;
+        std::vector<std::jthread> workers;
+    };
+
+
+    struct ParallelConfig {
+        size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+        size_t threshold = size_t{1} << 18;
+        std::unique_ptr<ThreadPool> pool;
+    };
+
+    inline ParallelConfig& parallel_config() {
+        static ParallelConfig config;
+        return config;
+    }
+
+    inline ThreadPool& thread_pool() {
+        auto& config = parallel_config();
+        static std::once_flag created;
+        std::call_once(created, [&] {
+            if (!config.pool) {
+                config.pool = std::make_unique<ThreadPool>(config.threads);
+            }
+        });
+        return *config.pool;
+    }
+} // namespace detail
+
+
+/* Number of threads used for parallel evaluation, including the caller; 0 means one per hardware thread.
+ * Must not be called while another thread is evaluating an expression. */
+inline void set_num_threads(size_t count) {
+    auto& config = detail::parallel_config();
+    config.threads = count > 0 ? count : std::max(std::thread::hardware_concurrency(), 1u);
+    config.pool = std::make_unique<detail::ThreadPool>(config.threads);
+}
+
+[[nodiscard]] inline size_t num_threads() {
+    return detail::parallel_config().threads;
+}
+
+/* Expressions with fewer elements than this are always evaluated on the calling thread */
+inline void set_parallel_threshold(size_t count) {
+    detail::parallel_config().threshold = count;
+}
+
+[[nodiscard]] inline size_t parallel_threshold() {
+    return detail::parallel_config().threshold;
+}
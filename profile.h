@@ -0,0 +1,421 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "operator.h"
+#include "parallel.h"
+#include "simd.h"
+#include "type_helper.h"
+
+
+/* Evaluation profiling, compiled in with TENSOR_PROFILE. Every assignment, reduction and any()/all() is then timed
+ * and passed to the function installed with set_profiler(); without the macro the hooks are empty and cost nothing. */
+#if defined(TENSOR_PROFILE)
+inline constexpr bool profiling = true;
+#else
+inline constexpr bool profiling = false;
+#endif
+
+
+/* One evaluation of an expression, as seen by the profiling hooks */
+struct EvaluationProfile {
+    enum class Kind { assign, reduce, test, scan, compress };
+
+    Kind kind;
+    std::string root;     /* operator at the root of the tree that ran, after simplify() */
+    size_t elements;
+    size_t bytes_read;    /* every leaf once, however often it appears; an upper bound for any() and all() */
+    size_t bytes_written;
+    double seconds;
+    size_t threads;       /* 1 when the calling thread evaluated everything */
+    bool simd;            /* false when no full packet fit and only the scalar loop ran */
+    bool broadcasting;    /* an operand is broadcast, so rows shorter than a packet are gathered lane by lane */
+
+    [[nodiscard]] double gigabytes_per_second() const {
+        return seconds > 0 ? static_cast<double>(bytes_read + bytes_written) / seconds * 1e-9 : 0;
+    }
+
+    [[nodiscard]] std::string to_string() const {
+        static constexpr const char* kinds[] = {"assign", "reduce", "test", "scan", "compress"};
+        char line[256];
+        std::snprintf(line, sizeof(line), "%s %s: %zu elements in %.3f us, %.2f GB/s, %s, %zu thread%s%s",
+                      kinds[static_cast<int>(kind)], root.c_str(), elements, seconds * 1e6, gigabytes_per_second(),
+                      simd ? "simd" : "scalar", threads, threads == 1 ? "" : "s", broadcasting ? ", broadcasting" : "");
+        return line;
+    }
+};
+
+
+namespace detail {
+    inline std::function<void(const EvaluationProfile&)>& profiler() {
+        static std::function<void(const EvaluationProfile&)> sink;
+        return sink;
+    }
+} // namespace detail
+
+
+/* Installs the function that receives a profile after every evaluation, or with an empty one stops profiling.
+ * Has no effect unless built with TENSOR_PROFILE; must not be called while another thread is evaluating. */
+inline void set_profiler(std::function<void(const EvaluationProfile&)> sink) {
+    detail::profiler() = std::move(sink);
+}
+
+
+namespace detail {
+    /* Node structure, read off the accessors each node type has; a leaf has none of them */
+    template <typename E, typename F>
+    constexpr void for_each_operand(const E& expr, F&& f) {
+        if constexpr (requires { expr.left(); }) {
+            f(expr.left());
+            f(expr.right());
+        } else if constexpr (requires { expr.first(); }) {
+            f(expr.first());
+            f(expr.second());
+            f(expr.third());
+        } else if constexpr (requires { expr.gathered(); }) {
+            f(expr.gathered());
+            f(expr.indices());
+        } else if constexpr (requires { expr.operand(); }) {
+            f(expr.operand());
+        }
+    }
+
+    template <typename E>
+    concept leaf = !numeric<E> && !requires (const E& e) { e.operand(); } && !requires (const E& e) { e.left(); } &&
+                   !requires (const E& e) { e.first(); } && !requires (const E& e) { e.gathered(); };
+
+    /* Bytes of memory behind the leaves of expr, each distinct leaf counted once */
+    template <typename E>
+    void collect_leaves(const E& expr, std::vector<std::pair<const void*, size_t>>& seen) {
+        if constexpr (leaf<E>) {
+            const void* identity = &expr;
+            if constexpr (requires { expr.data(); }) {
+                identity = expr.data();
+            }
+            size_t bytes = expr.size() * sizeof(typename E::element_type);
+            if constexpr (requires { expr.word_count(); }) {
+                bytes = expr.word_count() * sizeof(uint64_t);
+            }
+            if (std::ranges::find(seen, std::pair{identity, bytes}) == seen.end()) {
+                seen.emplace_back(identity, bytes);
+            }
+        } else if constexpr (!numeric<E>) {
+            for_each_operand(expr, [&](const auto& operand) { collect_leaves(operand, seen); });
+        }
+    }
+
+    template <typename E>
+    [[nodiscard]] size_t bytes_read(const E& expr) {
+        std::vector<std::pair<const void*, size_t>> seen;
+        collect_leaves(expr, seen);
+        size_t total = 0;
+        for (const auto& [identity, bytes] : seen) {
+            total += bytes;
+        }
+        return total;
+    }
+
+
+    /* Name and rough cost in flops per element of each operator */
+    struct OpInfo {
+        std::string name;
+        unsigned flops;
+    };
+
+    template <typename Op>
+    inline constexpr std::string_view op_name = "op";
+
+    template <typename Op>
+    inline constexpr unsigned op_flops = 1;
+
+    template <> inline constexpr std::string_view op_name<ComplOp> = "compl";
+    template <> inline constexpr std::string_view op_name<NegOp> = "neg";
+    template <> inline constexpr std::string_view op_name<AbsOp> = "abs";
+    template <> inline constexpr std::string_view op_name<SqrtOp> = "sqrt";
+    template <> inline constexpr std::string_view op_name<AndOp> = "&";
+    template <> inline constexpr std::string_view op_name<OrOp> = "|";
+    template <> inline constexpr std::string_view op_name<XorOp> = "^";
+    template <> inline constexpr std::string_view op_name<EqOp> = "==";
+    template <> inline constexpr std::string_view op_name<NeOp> = "!=";
+    template <> inline constexpr std::string_view op_name<LtOp> = "<";
+    template <> inline constexpr std::string_view op_name<LeOp> = "<=";
+    template <> inline constexpr std::string_view op_name<GtOp> = ">";
+    template <> inline constexpr std::string_view op_name<GeOp> = ">=";
+    template <> inline constexpr std::string_view op_name<AddOp> = "+";
+    template <> inline constexpr std::string_view op_name<SubOp> = "-";
+    template <> inline constexpr std::string_view op_name<MulOp> = "*";
+    template <> inline constexpr std::string_view op_name<DivOp> = "/";
+    template <> inline constexpr std::string_view op_name<ModOp> = "%";
+    template <typename L, typename R> inline constexpr std::string_view op_name<ScalarDivOp<L, R>> = "/";
+    template <typename L, typename R> inline constexpr std::string_view op_name<ScalarModOp<L, R>> = "%";
+    template <> inline constexpr std::string_view op_name<PowOp> = "pow";
+    template <> inline constexpr std::string_view op_name<MinOp> = "min";
+    template <> inline constexpr std::string_view op_name<MaxOp> = "max";
+    template <> inline constexpr std::string_view op_name<SelectOp> = "where";
+    template <> inline constexpr std::string_view op_name<FmaOp> = "fma";
+    template <> inline constexpr std::string_view op_name<FmsOp> = "fms";
+    template <> inline constexpr std::string_view op_name<FnmaOp> = "fnma";
+
+    /* A polynomial kernel with range reduction, precise or fast tier alike; pow is a log, a multiply and an exp */
+    inline constexpr unsigned transcendental_flops = 20;
+
+    template <> inline constexpr unsigned op_flops<PowOp> = 2 * transcendental_flops + 1;
+    template <> inline constexpr unsigned op_flops<FmaOp> = 2;
+    template <> inline constexpr unsigned op_flops<FmsOp> = 2;
+    template <> inline constexpr unsigned op_flops<FnmaOp> = 2;
+    /* A high multiply, an add and two shifts; the remainder adds a multiply and a subtract */
+    template <typename L, typename R> inline constexpr unsigned op_flops<ScalarDivOp<L, R>> = 4;
+    template <typename L, typename R> inline constexpr unsigned op_flops<ScalarModOp<L, R>> = 6;
+
+    template <template <Accuracy> typename Family>
+    inline constexpr std::string_view family_name = "";
+
+    template <> inline constexpr std::string_view family_name<ExpOp> = "exp";
+    template <> inline constexpr std::string_view family_name<LogOp> = "log";
+    template <> inline constexpr std::string_view family_name<Log10Op> = "log10";
+    template <> inline constexpr std::string_view family_name<SinOp> = "sin";
+    template <> inline constexpr std::string_view family_name<CosOp> = "cos";
+    template <> inline constexpr std::string_view family_name<TanOp> = "tan";
+    template <> inline constexpr std::string_view family_name<AsinOp> = "asin";
+    template <> inline constexpr std::string_view family_name<AcosOp> = "acos";
+    template <> inline constexpr std::string_view family_name<AtanOp> = "atan";
+    template <> inline constexpr std::string_view family_name<SinhOp> = "sinh";
+    template <> inline constexpr std::string_view family_name<CoshOp> = "cosh";
+    template <> inline constexpr std::string_view family_name<TanhOp> = "tanh";
+    template <> inline constexpr std::string_view family_name<AsinhOp> = "asinh";
+    template <> inline constexpr std::string_view family_name<AcoshOp> = "acosh";
+    template <> inline constexpr std::string_view family_name<AtanhOp> = "atanh";
+
+    template <template <Accuracy> typename Family, Accuracy A>
+    [[nodiscard]] std::string tier_name(Family<A>) {
+        return std::string(family_name<Family>) + (A == Accuracy::fast ? " (fast)" : "");
+    }
+
+    template <int N>
+    [[nodiscard]] constexpr int const_exponent(ConstPowOp<N>) {
+        return N;
+    }
+
+    /* Multiplications in a chain for x^n: one squaring per bit after the first, one multiply per further set bit */
+    [[nodiscard]] constexpr unsigned chain_flops(uint64_t n) {
+        return n == 0 ? 0 : static_cast<unsigned>(std::bit_width(n) + std::popcount(n) - 2);
+    }
+
+    template <typename Op>
+    [[nodiscard]] OpInfo op_info(const Op& op) {
+        if constexpr (requires { tier_name(op); }) {
+            return {tier_name(op), transcendental_flops};
+        } else if constexpr (requires { const_exponent(op); }) {
+            constexpr int N = const_exponent(Op{});
+            constexpr uint64_t magnitude = N < 0 ? uint64_t{0} - static_cast<uint64_t>(N) : static_cast<uint64_t>(N);
+            return {"pow<" + std::to_string(N) + ">", chain_flops(magnitude) + (N < 0)};
+        } else if constexpr (requires { op.divisor(); }) {
+            return {std::string(op_name<Op>) + " " + std::to_string(op.divisor()), op_flops<Op>};
+        } else if constexpr (requires { op.value(); }) {
+            /* The same classification ScalarPowOp makes when it is built */
+            const double e = static_cast<double>(op.value());
+            char name[64];
+            std::snprintf(name, sizeof(name), "pow %g", e);
+            if (e == 0.5) {
+                return {name, 1};
+            } else if (e == std::trunc(e) && std::abs(e) <= static_cast<double>(Op::max_chain)) {
+                return {name, chain_flops(static_cast<uint64_t>(std::abs(e))) + (e < 0)};
+            } else {
+                return {name, op_flops<PowOp>};
+            }
+        } else {
+            return {std::string(op_name<Op>), op_flops<Op>};
+        }
+    }
+
+    /* Label of a node without its operands: the operator, "cast", "gather", or the kind of leaf */
+    template <typename E>
+    [[nodiscard]] OpInfo node_info(const E& expr) {
+        if constexpr (requires { expr.operation(); }) {
+            return op_info(expr.operation());
+        } else if constexpr (requires { expr.gathered(); }) {
+            return {"gather", 0};
+        } else if constexpr (requires { expr.operand(); }) {
+            return {"cast", 1};
+        } else if constexpr (requires { expr.position(); }) {
+            return {"stream", 0};
+        } else if constexpr (requires { expr.word_count(); }) {
+            return {"mask", 0};
+        } else if constexpr (requires { typename E::allocator_type; }) {
+            return {"tensor", 0};
+        } else if constexpr (requires { expr.data(); }) {
+            return {"view", 0};
+        } else {
+            return {"strided view", 0};
+        }
+    }
+
+    template <typename E>
+    [[nodiscard]] unsigned flops_per_element(const E& expr) {
+        if constexpr (numeric<E>) {
+            return 0;
+        } else {
+            unsigned flops = node_info(expr).flops;
+            for_each_operand(expr, [&](const auto& operand) { flops += flops_per_element(operand); });
+            return flops;
+        }
+    }
+
+    /* common_type_t over the element types of the operands of a node */
+    template <typename E>
+    [[nodiscard]] std::string_view common_operand_type(const E& expr) {
+        using T = typename E::element_type;
+        std::string_view common = type_name<T>();
+        if constexpr (requires { expr.left(); }) {
+            using L = typename extract_element_type<std::remove_cvref_t<decltype(expr.left())>>::type;
+            using R = typename extract_element_type<std::remove_cvref_t<decltype(expr.right())>>::type;
+            common = type_name<common_type_t<L, R>>();
+        } else if constexpr (requires { { expr.operation() } -> std::same_as<SelectOp>; }) {
+            using A = typename extract_element_type<std::remove_cvref_t<decltype(expr.second())>>::type;
+            using B = typename extract_element_type<std::remove_cvref_t<decltype(expr.third())>>::type;
+            common = type_name<common_type_t<A, B>>();
+        } else if constexpr (requires { expr.first(); }) {
+            using A = typename extract_element_type<std::remove_cvref_t<decltype(expr.first())>>::type;
+            using B = typename extract_element_type<std::remove_cvref_t<decltype(expr.second())>>::type;
+            using C = typename extract_element_type<std::remove_cvref_t<decltype(expr.third())>>::type;
+            common = type_name<common_type_t<common_type_t<A, B>, C>>();
+        }
+        return common;
+    }
+
+    /* One line per node with its operands indented below it. Operands of an operator whose element type is not the
+     * common type of all its operands (the result type, for a unary operator) are listed as promotions. */
+    template <typename E>
+    void describe_node(std::string& out, const E& expr, const std::string& indent, std::string_view branch) {
+        out += indent;
+        out += branch;
+        if constexpr (numeric<E>) {
+            char value[64];
+            if constexpr (floating<compute_type<E>>) {
+                std::snprintf(value, sizeof(value), "%g", static_cast<double>(expr));
+            } else {
+                std::snprintf(value, sizeof(value), "%lld", static_cast<long long>(expr));
+            }
+            out += "scalar " + std::string(type_name<E>()) + " " + value + "\n";
+        } else {
+            using T = typename E::element_type;
+            out += node_info(expr).name + " -> " + std::string(type_name<T>()) + " " + expr.shape().to_string();
+            std::string promotions;
+            if constexpr (requires { expr.operation(); }) {
+                const std::string_view common = common_operand_type(expr);
+                /* The condition of a where is tested, not converted */
+                bool condition = std::is_same_v<decltype(expr.operation()), SelectOp>;
+                for_each_operand(expr, [&](const auto& operand) {
+                    using O = typename extract_element_type<std::remove_cvref_t<decltype(operand)>>::type;
+                    if (std::exchange(condition, false)) {
+                        return;
+                    }
+                    if (type_name<O>() != common) {
+                        promotions += (promotions.empty() ? "" : ", ") + std::string(type_name<O>()) + " -> " +
+                                      std::string(common);
+                    }
+                });
+            }
+            out += promotions.empty() ? "\n" : "  [promotes " + promotions + "]\n";
+
+            size_t remaining = 0;
+            for_each_operand(expr, [&](const auto&) { ++remaining; });
+            const std::string below = indent + (branch.empty() ? "" : branch == "`-- " ? "    " : "|   ");
+            for_each_operand(expr, [&](const auto& operand) {
+                describe_node(out, operand, below, --remaining == 0 ? "`-- " : "|-- ");
+            });
+        }
+    }
+
+    /* The tree, then what evaluating it into a fresh tensor costs: flops, bytes and the path evaluate() takes */
+    template <typename E>
+    [[nodiscard]] std::string describe(const E& expr) {
+        using T = typename E::element_type;
+        std::string out;
+        describe_node(out, expr, "", "");
+
+        const size_t count = expr.size();
+        const double flops = static_cast<double>(flops_per_element(expr)) * static_cast<double>(count);
+        const size_t read = bytes_read(expr);
+        const size_t written = count * sizeof(T);
+        char summary[256];
+        std::snprintf(summary, sizeof(summary),
+                      "%zu elements: ~%.4g flops, %zu bytes read, %zu written, ~%.3g flops/byte\n", count, flops, read,
+                      written, read + written > 0 ? flops / static_cast<double>(read + written) : 0.0);
+        out += summary;
+
+        std::string path = count < packet_size<T> ? "scalar loop" :
+                           "simd, " + std::to_string(packet_size<T>) + " x " + std::string(type_name<T>());
+        if (expr.broadcasting()) {
+            path += ", broadcast rows";
+        }
+        if (count >= parallel_threshold() && num_threads() > 1) {
+            path += ", parallel on " + std::to_string(num_threads()) + " threads";
+        }
+        return out + "path: " + path + "\n";
+    }
+
+
+    struct Unprofiled {};
+
+    /* Reports one evaluation to the profiler when it goes out of scope, unless an exception is unwinding it */
+    class ProfileScope {
+    public:
+        template <typename E>
+        ProfileScope(EvaluationProfile::Kind kind, const E& expr, size_t packet, size_t grain, size_t written_size)
+            : exceptions(std::uncaught_exceptions()), started(std::chrono::steady_clock::now()) {
+            if (!profiler()) {
+                return;
+            }
+            const size_t count = expr.size();
+            const bool parallel = count >= parallel_threshold();
+            record = EvaluationProfile{
+                kind, node_info(expr).name, count, bytes_read(expr), count * written_size, 0,
+                parallel ? std::min(thread_pool().size(), (count + grain - 1) / grain) : 1,
+                count >= packet, expr.broadcasting()};
+            active = true;
+            started = std::chrono::steady_clock::now();
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+        ~ProfileScope() {
+            if (active && std::uncaught_exceptions() == exceptions) {
+                record.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+                profiler()(record);
+            }
+        }
+
+    private:
+        EvaluationProfile record{};
+        int exceptions;
+        std::chrono::steady_clock::time_point started;
+        bool active = false;
+    };
+
+    /* The hook evaluate() and the reductions place around their work; an empty object without TENSOR_PROFILE */
+    template <typename E>
+    [[nodiscard]] auto profile(EvaluationProfile::Kind kind, const E& expr, size_t packet, size_t grain,
+                               size_t written_size) {
+        if constexpr (profiling) {
+            return ProfileScope(kind, expr, packet, grain, written_size);
+        } else {
+            return Unprofiled{};
+        }
+    }
+} // namespace detail
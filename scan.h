@@ -0,0 +1,183 @@
+#pragma once
+
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "tensor.h"
+
+
+/* Prefix scans. Element i of the result combines the input up to element i (inclusive) or up to the one before it
+ * (exclusive). The input may be any expression: it is evaluated a packet at a time as the scan reaches it and never
+ * stored. A scan runs over the elements in storage order, whatever the shape, and the result takes the input's
+ * shape. */
+
+enum class Scan {
+    inclusive, /* element i includes input i */
+    exclusive, /* element i stops short of input i; element 0 is the identity: 0, 1, the largest value or the lowest */
+};
+
+
+namespace detail {
+    /* Inclusive scan across the lanes of x, in log2(N) steps that each combine x with itself shifted up */
+    template <numeric A, size_t N, typename Op>
+    [[nodiscard]] constexpr Packet<A, N> scan_lanes(Packet<A, N> x, Op op) {
+        [&]<size_t... S>(std::index_sequence<S...>) {
+            ((x = op(x, x.template shift_up<size_t{1} << S>(identity_of<A>(op)))), ...);
+        }(std::make_index_sequence<std::bit_width(N) - 1>{});
+        return x;
+    }
+
+    /* Scans [first, last) from the identity and returns the total. Unless out is null, element i is written as
+     * op(carry, scan up to i). The total does not depend on carry, so a pass that only finds the totals of the blocks
+     * sees bit for bit what the writing pass does. */
+    template <Scan S, numeric A, numeric R, typename E, typename Op>
+    A scan_block(R* out, const E& expr, size_t first, size_t last, A carry, Op op) {
+        constexpr size_t N = packet_size<A>;
+        const auto carried = Packet<A, N>::broadcast(carry);
+        A total = identity_of<A>(op);
+        size_t i = first;
+        for (; i + N <= last; i += N) {
+            const auto lanes = scan_lanes(expr.template packet<N>(i).template as<A>(), op);
+            const auto running = op(Packet<A, N>::broadcast(total), lanes);
+            if (out != nullptr) {
+                if constexpr (S == Scan::inclusive) {
+                    op(carried, running).store_as(out + i);
+                } else {
+                    op(carried, running.template shift_up<1>(total)).store_as(out + i);
+                }
+            }
+            total = running[N - 1];
+        }
+        for (; i < last; ++i) {
+            const A before = total;
+            total = static_cast<A>(op(total, static_cast<A>(expr[i])));
+            if (out != nullptr) {
+                out[i] = static_cast<R>(op(carry, S == Scan::inclusive ? total : before));
+            }
+        }
+        return total;
+    }
+
+    /* Blocks are fixed grains whatever the thread count. The first pass finds the total of every block, a serial scan
+     * of the totals gives every block its carry, and the second pass scans each block again from its carry, so the
+     * input is read twice and the result written once. Below the parallel threshold, or with a single thread, one
+     * pass does both in order with the same arithmetic, so the result does not depend on whether the scan ran in
+     * parallel. */
+    template <Scan S, numeric A, numeric R, typename E, typename Op>
+    void scan(R* out, const E& expr, Op op) {
+        constexpr size_t grain = parallel_grain<A>;
+        [[maybe_unused]] const auto probe = profile(EvaluationProfile::Kind::scan, expr, packet_size<A>, grain,
+                                                    sizeof(R));
+        const size_t count = expr.size();
+        if (count < parallel_threshold() || thread_pool().size() == 1) {
+            A carry = identity_of<A>(op);
+            for (size_t begin = 0; begin < count; begin += grain) {
+                const A total = scan_block<S>(out, expr, begin, std::min(begin + grain, count), carry, op);
+                carry = static_cast<A>(op(carry, total));
+            }
+            return;
+        }
+
+        std::vector<A> carries((count + grain - 1) / grain);
+        thread_pool().parallel_for(count, grain, [&](size_t first, size_t last) {
+            for (size_t begin = first; begin < last; begin += grain) {
+                carries[begin / grain] = scan_block<S>(static_cast<R*>(nullptr), expr, begin,
+                                                       std::min(begin + grain, last), identity_of<A>(op), op);
+            }
+        });
+        A carry = identity_of<A>(op);
+        for (A& c : carries) {
+            const A total = c;
+            c = carry;
+            carry = static_cast<A>(op(carry, total));
+        }
+        thread_pool().parallel_for(count, grain, [&](size_t first, size_t last) {
+            for (size_t begin = first; begin < last; begin += grain) {
+                scan_block<S>(out, expr, begin, std::min(begin + grain, last), carries[begin / grain], op);
+            }
+        });
+    }
+
+    template <Scan S, numeric A, numeric R, typename E, typename Op>
+    [[nodiscard]] Tensor<R> scanned(const E& expr, Op op) {
+        Tensor<R> result(expr.shape());
+        scan<S, A>(result.data(), simplify(expr), op);
+        return result;
+    }
+
+    /* Scans into memory that exists already. Reading the element being written, as in an in-place scan, is safe;
+     * reading any other part of the output goes through a temporary. */
+    template <Scan S, numeric A, numeric R, typename E, typename Op>
+    TensorView<R> scanned_into(TensorView<R> out, const E& expr, Op op) {
+        if (expr.size() != out.size()) {
+            throw std::invalid_argument("Scan: cannot write " + expr.shape().to_string() + " to " +
+                                        out.shape().to_string());
+        }
+        if (expr.aliases(Footprint::of(out.data(), 1, out.size()))) {
+            const Tensor<R> result = scanned<S, A, R>(expr, op);
+            std::copy_n(result.data(), result.size(), out.data());
+        } else {
+            scan<S, A>(out.data(), simplify(expr), op);
+        }
+        return out;
+    }
+} // namespace detail
+
+
+/* Running sum; integers accumulate in 64 bits and 16-bit floats in float, and the result has that type, as for sum() */
+template <Scan S = Scan::inclusive, std::derived_from<detail::Expr> E>
+[[nodiscard]] auto cumsum(const E& expr) {
+    using A = detail::accumulator_type<typename E::element_type>;
+    return detail::scanned<S, A, A>(expr, detail::AddOp{});
+}
+
+/* Running product, of the same type as prod() */
+template <Scan S = Scan::inclusive, std::derived_from<detail::Expr> E>
+[[nodiscard]] auto cumprod(const E& expr) {
+    using A = detail::accumulator_type<typename E::element_type>;
+    return detail::scanned<S, A, A>(expr, detail::MulOp{});
+}
+
+/* Running minimum, of the input's element type; NaNs are skipped, as by min() */
+template <Scan S = Scan::inclusive, std::derived_from<detail::Expr> E>
+[[nodiscard]] auto cummin(const E& expr) {
+    using T = typename E::element_type;
+    return detail::scanned<S, detail::compute_type<T>, T>(expr, detail::MinOp{});
+}
+
+/* Running maximum, of the input's element type; NaNs are skipped, as by max() */
+template <Scan S = Scan::inclusive, std::derived_from<detail::Expr> E>
+[[nodiscard]] auto cummax(const E& expr) {
+    using T = typename E::element_type;
+    return detail::scanned<S, detail::compute_type<T>, T>(expr, detail::MaxOp{});
+}
+
+/* The same scans into out, for example TensorView(t) to reuse the storage of a tensor t, or to scan t in place.
+ * The elements are computed as above and converted to out's element type; throws std::invalid_argument when the
+ * sizes differ. */
+template <Scan S = Scan::inclusive, detail::numeric R, std::derived_from<detail::Expr> E>
+TensorView<R> cumsum(TensorView<R> out, const E& expr) {
+    using A = detail::accumulator_type<typename E::element_type>;
+    return detail::scanned_into<S, A>(out, expr, detail::AddOp{});
+}
+
+template <Scan S = Scan::inclusive, detail::numeric R, std::derived_from<detail::Expr> E>
+TensorView<R> cumprod(TensorView<R> out, const E& expr) {
+    using A = detail::accumulator_type<typename E::element_type>;
+    return detail::scanned_into<S, A>(out, expr, detail::MulOp{});
+}
+
+template <Scan S = Scan::inclusive, detail::numeric R, std::derived_from<detail::Expr> E>
+TensorView<R> cummin(TensorView<R> out, const E& expr) {
+    return detail::scanned_into<S, detail::compute_type<typename E::element_type>>(out, expr, detail::MinOp{});
+}
+
+template <Scan S = Scan::inclusive, detail::numeric R, std::derived_from<detail::Expr> E>
+TensorView<R> cummax(TensorView<R> out, const E& expr) {
+    return detail::scanned_into<S, detail::compute_type<typename E::element_type>>(out, expr, detail::MaxOp{});
+}
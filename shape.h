@@ -0,0 +1,183 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "simd.h"
+#include "type_helper.h"
+
+
+/* Extents of a row-major tensor, outermost first; rank 0 is a single element */
+struct Shape {
+    static constexpr size_t max_rank = 8;
+
+
+    constexpr Shape() = default;
+
+    explicit constexpr Shape(size_t count) : dims{count}, dims_count(1) {}
+
+    constexpr Shape(std::initializer_list<size_t> extents) : dims_count(extents.size()) {
+        if (extents.size() > max_rank) {
+            throw std::length_error("Shape: rank " + std::to_string(extents.size()) + " exceeds max_rank");
+        }
+        std::ranges::copy(extents, dims.begin());
+    }
+
+    /* Extents whose rank is only known at run time, such as those read from a file */
+    explicit constexpr Shape(std::span<const size_t> extents) : dims_count(extents.size()) {
+        if (extents.size() > max_rank) {
+            throw std::length_error("Shape: rank " + std::to_string(extents.size()) + " exceeds max_rank");
+        }
+        std::ranges::copy(extents, dims.begin());
+    }
+
+    [[nodiscard]] constexpr size_t rank() const {
+        return dims_count;
+    }
+
+    [[nodiscard]] constexpr size_t size() const {
+        size_t count = 1;
+        for (size_t d = 0; d < dims_count; ++d) {
+            count *= dims[d];
+        }
+        return count;
+    }
+
+    [[nodiscard]] constexpr size_t operator[](size_t d) const {
+        return dims[d];
+    }
+
+    [[nodiscard]] constexpr size_t back() const {
+        return dims_count > 0 ? dims[dims_count - 1] : 1;
+    }
+
+    /* Element strides of the contiguous row-major layout */
+    [[nodiscard]] constexpr std::array<size_t, max_rank> strides() const {
+        std::array<size_t, max_rank> result{};
+        size_t stride = 1;
+        for (size_t d = dims_count; d-- > 0;) {
+            result[d] = stride;
+            stride *= dims[d];
+        }
+        return result;
+    }
+
+    [[nodiscard]] constexpr const size_t* begin() const {
+        return dims.data();
+    }
+
+    [[nodiscard]] constexpr const size_t* end() const {
+        return dims.data() + dims_count;
+    }
+
+    friend constexpr bool operator==(const Shape& lhs, const Shape& rhs) {
+        return std::ranges::equal(lhs, rhs);
+    }
+
+    /* NumPy rules: align trailing dimensions; each pair must match or one of them must be 1 */
+    [[nodiscard]] static Shape broadcast(const Shape& lhs, const Shape& rhs) {
+        const size_t rank = std::max(lhs.rank(), rhs.rank());
+        Shape result;
+        result.dims_count = rank;
+        for (size_t d = 0; d < rank; ++d) {
+            const size_t l = d < lhs.rank() ? lhs.dims[lhs.rank() - 1 - d] : 1;
+            const size_t r = d < rhs.rank() ? rhs.dims[rhs.rank() - 1 - d] : 1;
+            if (l != r && l != 1 && r != 1) {
+                throw std::invalid_argument("Shape: cannot broadcast " + lhs.to_string() + " with " + rhs.to_string());
+            }
+            result.dims[rank - 1 - d] = l == 1 ? r : l;
+        }
+        return result;
+    }
+
+    [[nodiscard]] std::string to_string() const {
+        std::string result = "(";
+        for (size_t d = 0; d < dims_count; ++d) {
+            result += (d > 0 ? ", " : "") + std::to_string(dims[d]);
+        }
+        return result + ")";
+    }
+
+private:
+    std::array<size_t, max_rank> dims{};
+    size_t dims_count = 0;
+};
+
+
+namespace detail {
+    /* Maps a flat index into a broadcast result onto the flat index of an operand with a smaller shape */
+    class BroadcastMap {
+    public:
+        constexpr BroadcastMap() = default;
+
+        constexpr BroadcastMap(const Shape& from, const Shape& to) {
+            if (from == to) {
+                return;
+            }
+            is_identity = false;
+            rank = to.rank();
+            const auto contiguous = from.strides();
+            for (size_t d = 0; d < rank; ++d) {
+                extents[d] = to[d];
+                const size_t offset = rank - from.rank();
+                strides[d] = d >= offset && from[d - offset] == to[d] ? contiguous[d - offset] : 0;
+            }
+        }
+
+        [[nodiscard]] constexpr bool identity() const {
+            return is_identity;
+        }
+
+        [[nodiscard]] constexpr size_t operator()(size_t i) const {
+            if (is_identity) {
+                return i;
+            }
+            size_t offset = 0;
+            for (size_t d = rank; d-- > 0;) {
+                offset += i % extents[d] * strides[d];
+                i /= extents[d];
+            }
+            return offset;
+        }
+
+        /* One index decomposition per packet while it stays inside a row; lane by lane across rows */
+        template <size_t N, typename E>
+        [[nodiscard]] constexpr auto packet(const E& expr, size_t i) const {
+            using P = Packet<typename E::element_type, N>;
+            if (is_identity) {
+                return expr.template packet<N>(i);
+            }
+            const size_t inner = rank > 0 ? extents[rank - 1] : 1;
+            if (i % inner + N <= inner) {
+                const size_t base = (*this)(i);
+                return strides[rank - 1] != 0 ? expr.template packet<N>(base) : P::broadcast(expr[base]);
+            }
+            P result;
+            for (size_t k = 0; k < N; ++k) {
+                result.set(k, expr[(*this)(i + k)]);
+            }
+            return result;
+        }
+
+    private:
+        std::array<size_t, Shape::max_rank> extents{};
+        std::array<size_t, Shape::max_rank> strides{};
+        size_t rank = 0;
+        bool is_identity = true;
+    };
+
+    template <typename T>
+    [[nodiscard]] constexpr Shape shape_of(const T& operand) {
+        if constexpr (numeric<T>) {
+            return Shape{};
+        } else {
+            return operand.shape();
+        }
+    }
+} // namespace detail
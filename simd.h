@@ -0,0 +1,526 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#include "type_helper.h"
+
+
+namespace detail {
+    /* Register width in bytes, picked from the target ISA at compile time */
+#if defined(__AVX512F__)
+    inline constexpr size_t simd_width = 64;
+#elif defined(__AVX2__)
+    inline constexpr size_t simd_width = 32;
+#else /* SSE2, NEON, or whatever the compiler lowers generic vectors to */
+    inline constexpr size_t simd_width = 16;
+#endif
+
+    /* bool lanes are stored as 0/1 bytes, which is also the object representation of bool. 16-bit floats are held
+     * in float lanes: load() widens them and store() rounds them back. */
+    template <numeric T>
+    using lane_type = std::conditional_t<std::is_same_v<std::remove_cv_t<T>, bool>, uint8_t, compute_type<T>>;
+
+    /* Whether x * y + z with a single rounding is one instruction rather than a libm call */
+#if defined(__FMA__) || defined(__ARM_FEATURE_FMA)
+    inline constexpr bool hardware_fma = true;
+#else
+    inline constexpr bool hardware_fma = false;
+#endif
+
+    template <numeric T>
+    inline constexpr size_t packet_size = simd_width / sizeof(lane_type<T>);
+
+    template <size_t Size>
+    using mask_lane_type = std::conditional_t<Size == 1, int8_t,
+                           std::conditional_t<Size == 2, int16_t,
+                           std::conditional_t<Size == 4, int32_t, int64_t>>>;
+
+
+    /* N 16-bit floats between their bits and float lanes, rounding to nearest even like the scalar conversions.
+     * F16C converts binary16 in one instruction; otherwise, and for bfloat16, the scalar encode() and decode() of
+     * half.h run on all lanes at once. */
+    template <half_floating T, size_t N>
+    struct HalfLanes {
+        using wide_lane = lane_type<T>;
+        using signed_lane = mask_lane_type<sizeof(wide_lane)>;
+        using word_lane = std::make_unsigned_t<signed_lane>;
+        using bits_lane = std::make_unsigned_t<mask_lane_type<sizeof(T)>>;
+
+        typedef wide_lane wide_type __attribute__((vector_size(N * sizeof(wide_lane))));
+        typedef bits_lane bits_type __attribute__((vector_size(N * sizeof(bits_lane))));
+        typedef word_lane word_type __attribute__((vector_size(N * sizeof(word_lane))));
+        typedef signed_lane signed_type __attribute__((vector_size(N * sizeof(signed_lane))));
+
+
+        [[nodiscard]] static wide_type widen(const bits_type& bits) {
+            if constexpr (std::is_same_v<std::remove_cv_t<T>, bfloat16>) {
+                return (wide_type) (__builtin_convertvector(bits, word_type) << 16);
+            } else {
+#if defined(__F16C__)
+                if constexpr (N == 4) {
+                    __m128i in = _mm_setzero_si128();
+                    std::memcpy(&in, &bits, sizeof(bits));
+                    return (wide_type) _mm_cvtph_ps(in);
+                } else if constexpr (N == 8) {
+                    return (wide_type) _mm256_cvtph_ps((__m128i) bits);
+                }
+#if defined(__AVX512F__)
+                /* The zero-masked forms, as the plain ones start from an undefined register GCC 12 warns about */
+                if constexpr (N == 16) {
+                    return (wide_type) _mm512_maskz_cvtph_ps(0xffff, (__m256i) bits);
+                }
+#endif
+#endif
+                const word_type magnitude = __builtin_convertvector(bits & 0x7fff, word_type) << 13;
+                const word_type exponent = magnitude & 0x0f800000u;
+                const word_type f = magnitude + 0x38000000u;
+                const word_type special = f + 0x38000000u;
+                const word_type subnormal =
+                    (word_type) ((wide_type) (f + 0x00800000u) - std::bit_cast<float>(0x38800000u));
+                const word_type w = exponent == 0x0f800000u ? special : exponent == 0 ? subnormal : f;
+                return (wide_type) (w | __builtin_convertvector(bits & 0x8000, word_type) << 16);
+            }
+        }
+
+        [[nodiscard]] static bits_type narrow(const wide_type& x) {
+            const word_type f = (word_type) x;
+            if constexpr (std::is_same_v<std::remove_cv_t<T>, bfloat16>) {
+                const word_type rounded = (f + 0x7fffu + ((f >> 16) & 1)) >> 16;
+                const word_type nan = f >> 16 | 0x0040u;
+                return __builtin_convertvector((signed_type) (f & 0x7fffffffu) > 0x7f800000 ? nan : rounded, bits_type);
+            } else {
+#if defined(__F16C__)
+                if constexpr (N == 4) {
+                    const __m128i out = _mm_cvtps_ph((__m128) x, _MM_FROUND_TO_NEAREST_INT);
+                    bits_type bits;
+                    std::memcpy(&bits, &out, sizeof(bits));
+                    return bits;
+                } else if constexpr (N == 8) {
+                    return (bits_type) _mm256_cvtps_ph((__m256) x, _MM_FROUND_TO_NEAREST_INT);
+                }
+#if defined(__AVX512F__)
+                if constexpr (N == 16) {
+                    return (bits_type) _mm512_maskz_cvtps_ph(0xffff, (__m512) x, _MM_FROUND_TO_NEAREST_INT);
+                }
+#endif
+#endif
+                const word_type sign = f & 0x80000000u;
+                const word_type magnitude = f ^ sign;
+                /* Below the sign bit, so signed comparisons (all SSE2 has) order magnitudes correctly */
+                const signed_type m = (signed_type) magnitude;
+                const word_type special = m > 0x7f800000 ? word_type{} + 0x7e00u : word_type{} + 0x7c00u;
+                const word_type subnormal = (word_type) ((wide_type) magnitude + 0.5f) - 0x3f000000u;
+                const word_type normal = (magnitude + 0xc8000fffu + ((magnitude >> 13) & 1)) >> 13;
+                const word_type h = m >= 0x47800000 ? special : m < 0x38800000 ? subnormal : normal;
+                return __builtin_convertvector(h | sign >> 16, bits_type);
+            }
+        }
+    };
+
+
+    template <numeric T, size_t N>
+    struct Packet {
+        using element_type = std::remove_cv_t<T>;
+        using lane = lane_type<T>;
+        typedef lane vector_type __attribute__((vector_size(N * sizeof(lane))));
+        typedef mask_lane_type<sizeof(lane)> mask_type __attribute__((vector_size(N * sizeof(lane))));
+
+        static constexpr size_t size = N;
+
+
+        [[nodiscard]] static Packet load(const element_type* src) {
+            Packet p;
+            if constexpr (half_floating<element_type>) {
+                typename HalfLanes<element_type, N>::bits_type bits;
+                std::memcpy(&bits, static_cast<const void*>(src), sizeof(bits));
+                p.v = HalfLanes<element_type, N>::widen(bits);
+            } else {
+                std::memcpy(&p.v, src, sizeof(vector_type));
+            }
+            return p;
+        }
+
+        [[nodiscard]] static constexpr Packet broadcast(element_type value) {
+            /* x - 0 rather than 0 + x, which would turn -0.0 into +0.0 */
+            return {static_cast<lane>(value) - vector_type{}};
+        }
+
+        /* Lanes of a comparison result (all ones / all zeros) to bool lanes */
+        template <typename M>
+        requires std::is_same_v<element_type, bool>
+        [[nodiscard]] static constexpr Packet from_mask(M mask) {
+            return {__builtin_convertvector(mask & 1, vector_type)};
+        }
+
+        void store(element_type* dst) const {
+            if constexpr (half_floating<element_type>) {
+                const auto bits = HalfLanes<element_type, N>::narrow(v);
+                std::memcpy(static_cast<void*>(dst), &bits, sizeof(bits));
+            } else {
+                std::memcpy(dst, &v, sizeof(vector_type));
+            }
+        }
+
+        /* as<U>().store(dst), but rounding only once when U is a 16-bit float */
+        template <numeric U>
+        void store_as(U* dst) const {
+            if constexpr (half_floating<U> && !std::is_same_v<element_type, std::remove_cv_t<U>>) {
+                const auto bits = narrowed<std::remove_cv_t<U>>();
+                std::memcpy(static_cast<void*>(dst), &bits, sizeof(bits));
+            } else {
+                as<U>().store(dst);
+            }
+        }
+
+        /* Converting to a 16-bit float rounds, so that the lanes hold only values an element of U can */
+        template <numeric U>
+        [[nodiscard]] constexpr Packet<U, N> as() const {
+            if constexpr (std::is_same_v<element_type, std::remove_cv_t<U>>) {
+                return *this;
+            } else if constexpr (std::is_same_v<std::remove_cv_t<U>, bool>) {
+                return Packet<U, N>::from_mask(v != 0);
+            } else if constexpr (half_floating<U>) {
+                return {HalfLanes<std::remove_cv_t<U>, N>::widen(narrowed<std::remove_cv_t<U>>())};
+            } else {
+                return {__builtin_convertvector(v, typename Packet<U, N>::vector_type)};
+            }
+        }
+
+        /* All ones in every lane where this bool packet is true, sized to match the lanes of U */
+        template <numeric U>
+        requires std::is_same_v<element_type, bool>
+        [[nodiscard]] constexpr auto mask_for() const {
+            using M = typename Packet<U, N>::mask_type;
+            return -__builtin_convertvector(v, M);
+        }
+
+        /* Lanes in the opposite order, for walking memory backwards */
+        [[nodiscard]] constexpr Packet reverse() const {
+            return [&]<size_t... I>(std::index_sequence<I...>) {
+                return Packet{__builtin_shufflevector(v, v, (N - 1 - I)...)};
+            }(std::make_index_sequence<N>{});
+        }
+
+        /* Lanes moved K places up, lane i to lane i + K, with fill in the K lowest lanes */
+        template <size_t K>
+        [[nodiscard]] constexpr Packet shift_up(element_type fill) const {
+            const vector_type low = broadcast(fill).v;
+            if constexpr (K >= N) {
+                return {low};
+            } else {
+                return [&]<size_t... I>(std::index_sequence<I...>) {
+                    return Packet{__builtin_shufflevector(v, low, (I < K ? N + I : I - K)...)};
+                }(std::make_index_sequence<N>{});
+            }
+        }
+
+        [[nodiscard]] constexpr element_type operator[](size_t i) const {
+            return static_cast<element_type>(v[i]);
+        }
+
+        constexpr void set(size_t i, element_type value) {
+            v[i] = static_cast<lane>(value);
+        }
+
+        friend constexpr Packet operator-(const Packet& x) {
+            return {-x.v};
+        }
+
+        friend constexpr Packet operator~(const Packet& x) {
+            return {~x.v};
+        }
+
+        friend constexpr Packet operator+(const Packet& x, const Packet& y) {
+            return {x.v + y.v};
+        }
+
+        friend constexpr Packet operator-(const Packet& x, const Packet& y) {
+            return {x.v - y.v};
+        }
+
+        friend constexpr Packet operator*(const Packet& x, const Packet& y) {
+            return {x.v * y.v};
+        }
+
+        friend constexpr Packet operator/(const Packet& x, const Packet& y) {
+            return {x.v / y.v};
+        }
+
+        friend constexpr Packet operator%(const Packet& x, const Packet& y) {
+            return {x.v % y.v};
+        }
+
+        friend constexpr Packet operator&(const Packet& x, const Packet& y) {
+            return {x.v & y.v};
+        }
+
+        friend constexpr Packet operator|(const Packet& x, const Packet& y) {
+            return {x.v | y.v};
+        }
+
+        friend constexpr Packet operator^(const Packet& x, const Packet& y) {
+            return {x.v ^ y.v};
+        }
+
+        friend constexpr Packet<bool, N> operator==(const Packet& x, const Packet& y) {
+            return Packet<bool, N>::from_mask(x.v == y.v);
+        }
+
+        friend constexpr Packet<bool, N> operator!=(const Packet& x, const Packet& y) {
+            return Packet<bool, N>::from_mask(x.v != y.v);
+        }
+
+        friend constexpr Packet<bool, N> operator<(const Packet& x, const Packet& y) {
+            return Packet<bool, N>::from_mask(x.v < y.v);
+        }
+
+        friend constexpr Packet<bool, N> operator<=(const Packet& x, const Packet& y) {
+            return Packet<bool, N>::from_mask(x.v <= y.v);
+        }
+
+        friend constexpr Packet<bool, N> operator>(const Packet& x, const Packet& y) {
+            return Packet<bool, N>::from_mask(x.v > y.v);
+        }
+
+        friend constexpr Packet<bool, N> operator>=(const Packet& x, const Packet& y) {
+            return Packet<bool, N>::from_mask(x.v >= y.v);
+        }
+
+        /* The bits of the lanes rounded to H; wider lanes are rounded to odd in float first, as HalfFloat does */
+        template <half_floating H>
+        [[nodiscard]] auto narrowed() const {
+            using Lanes = HalfLanes<H, N>;
+            if constexpr (std::is_same_v<lane, float> || sizeof(lane) <= 2) {
+                return Lanes::narrow(__builtin_convertvector(v, typename Lanes::wide_type));
+            } else {
+                return Lanes::narrow(as<double>().rounded_to_odd());
+            }
+        }
+
+        /* round_to_odd() on every lane */
+        [[nodiscard]] auto rounded_to_odd() const requires std::is_same_v<element_type, double> {
+            using F = typename Packet<float, N>::vector_type;
+            using I = typename Packet<float, N>::mask_type;
+            const F f = __builtin_convertvector(v, F);
+            const vector_type back = __builtin_convertvector(f, vector_type);
+            const I inexact = __builtin_convertvector(back != v, I);
+            const I away = __builtin_convertvector((vector_type) ((mask_type) v & INT64_MAX) >
+                                                   (vector_type) ((mask_type) back & INT64_MAX), I);
+            const I bits = (I) f;
+            const I fix = inexact & ((bits & 1) == 0) & ((bits & 0x7f800000) != 0x7f800000);
+            /* One step away from zero where |v| > |f|, towards it otherwise */
+            return (F) (bits + (fix & (-2 * away - 1)));
+        }
+
+        vector_type v;
+    };
+
+
+    /* Branchless per-lane choice: cond ? x : y */
+    template <numeric T, size_t N>
+    [[nodiscard]] constexpr Packet<T, N> select(const Packet<bool, N>& cond, const Packet<T, N>& x,
+                                                const Packet<T, N>& y) {
+        using V = typename Packet<T, N>::vector_type;
+        using M = typename Packet<T, N>::mask_type;
+        const M m = cond.template mask_for<T>();
+        return {(V) ((m & (M) x.v) | (~m & (M) y.v))};
+    }
+
+    /* Horizontal tests on bool packets, eight lanes per 64-bit word when the packet allows it */
+    template <size_t N>
+    [[nodiscard]] bool any_of(const Packet<bool, N>& p) {
+        if constexpr (N % 8 == 0) {
+            uint64_t words[N / 8];
+            std::memcpy(words, &p.v, sizeof(words));
+            uint64_t acc = 0;
+            for (uint64_t word : words) {
+                acc |= word;
+            }
+            return acc != 0;
+        } else {
+            uint8_t acc = 0;
+            for (size_t i = 0; i < N; ++i) {
+                acc |= p.v[i];
+            }
+            return acc != 0;
+        }
+    }
+
+    template <size_t N>
+    [[nodiscard]] bool all_of(const Packet<bool, N>& p) {
+        return !any_of(Packet<bool, N>{p.v ^ 1});
+    }
+
+    /* Bool lanes to the low N bits of a word, lane i to bit i, and back. Eight lanes at a time without a mask
+     * instruction: multiplying gathers the low bit of every byte into the top byte, and the way back isolates bit k
+     * in byte k and lets an add carry it into the top bit of the byte. */
+    template <size_t N>
+    requires (N <= 64)
+    [[nodiscard]] uint64_t bits_of(const Packet<bool, N>& p) {
+#if defined(__AVX512BW__)
+        if constexpr (N == 64) {
+            return _mm512_test_epi8_mask((__m512i) p.v, (__m512i) p.v);
+        }
+#endif
+#if defined(__AVX2__)
+        if constexpr (N == 32) {
+            return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16((__m256i) p.v, 7)));
+        }
+#endif
+        uint64_t bits = 0;
+        for (size_t k = 0; k < N; k += 8) {
+            uint64_t bytes = 0;
+            std::memcpy(&bytes, reinterpret_cast<const uint8_t*>(&p.v) + k, std::min<size_t>(8, N - k));
+            bits |= (bytes * 0x0102040810204080u >> 56) << k;
+        }
+        return bits;
+    }
+
+    template <size_t N>
+    requires (N <= 64)
+    [[nodiscard]] Packet<bool, N> from_bits(uint64_t bits) {
+        Packet<bool, N> p;
+#if defined(__AVX512BW__)
+        if constexpr (N == 64) {
+            p.v = (typename Packet<bool, N>::vector_type) _mm512_maskz_mov_epi8(bits, _mm512_set1_epi8(1));
+            return p;
+        }
+#endif
+        for (size_t k = 0; k < N; k += 8) {
+            const uint64_t byte = bits >> k & 0xff;
+            const uint64_t bytes =
+                (((byte * 0x0101010101010101u) & 0x8040201008040201u) + 0x7f7f7f7f7f7f7f7fu) >> 7 & 0x0101010101010101u;
+            std::memcpy(reinterpret_cast<uint8_t*>(&p.v) + k, &bytes, std::min<size_t>(8, N - k));
+        }
+        return p;
+    }
+
+    /* For every 8-bit mask, the positions of its set bits in ascending order, one per byte: the permutation that
+     * left-packs eight 32-bit lanes */
+    inline constexpr std::array<uint64_t, 256> left_pack_indices = [] {
+        std::array<uint64_t, 256> table{};
+        for (size_t mask = 0; mask < table.size(); ++mask) {
+            size_t k = 0;
+            for (uint64_t lane = 0; lane < 8; ++lane) {
+                if (mask >> lane & 1) {
+                    table[mask] |= lane << (8 * k++);
+                }
+            }
+        }
+        return table;
+    }();
+
+    /* Stores the lanes of p whose bit is set, lane i at bit i, next to each other from dst in lane order, and returns
+     * how many. AVX-512 has compress instructions for it and AVX2 a lane permute driven by left_pack_indices; both
+     * store a whole packet, so dst needs room for N elements whatever the count. Elsewhere every lane is stored and
+     * the position only advances past the selected ones, which does not branch on the bits. */
+    template <numeric T, size_t N>
+    size_t compress_store(T* dst, const Packet<T, N>& p, uint64_t bits) {
+        [[maybe_unused]] constexpr size_t width = sizeof(typename Packet<T, N>::vector_type);
+        [[maybe_unused]] constexpr bool packed = sizeof(typename Packet<T, N>::lane) == sizeof(T);
+        [[maybe_unused]] const auto count = static_cast<size_t>(std::popcount(bits));
+#if defined(__AVX512F__)
+        if constexpr (packed && width == 64 && sizeof(T) == 4) {
+            _mm512_storeu_si512(dst, _mm512_maskz_compress_epi32(static_cast<__mmask16>(bits), (__m512i) p.v));
+            return count;
+        }
+        if constexpr (packed && width == 64 && sizeof(T) == 8) {
+            _mm512_storeu_si512(dst, _mm512_maskz_compress_epi64(static_cast<__mmask8>(bits), (__m512i) p.v));
+            return count;
+        }
+#endif
+#if defined(__AVX512VBMI2__)
+        if constexpr (packed && width == 64 && sizeof(T) == 2) {
+            _mm512_storeu_si512(dst, _mm512_maskz_compress_epi16(static_cast<__mmask32>(bits), (__m512i) p.v));
+            return count;
+        }
+        if constexpr (packed && width == 64 && sizeof(T) == 1) {
+            _mm512_storeu_si512(dst, _mm512_maskz_compress_epi8(static_cast<__mmask64>(bits), (__m512i) p.v));
+            return count;
+        }
+#endif
+#if defined(__AVX2__)
+        if constexpr (packed && width == 32 && sizeof(T) >= 4) {
+            uint64_t mask = bits;
+            if constexpr (sizeof(T) == 8) {
+                /* Each 64-bit lane is a pair of 32-bit ones: bit i of four becomes bits 2i and 2i + 1 of eight */
+                mask = (mask | mask << 2) & 0x33;
+                mask = (mask | mask << 1) & 0x55;
+                mask |= mask << 1;
+            }
+            const auto positions = static_cast<long long>(left_pack_indices[mask]);
+            const __m256i index = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(positions));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permutevar8x32_epi32((__m256i) p.v, index));
+            return count;
+        }
+#endif
+        size_t k = 0;
+        for (size_t i = 0; i < N; ++i) {
+            dst[k] = p[i];
+            k += bits >> i & 1;
+        }
+        return k;
+    }
+
+    /* Lane type and comparison-mask type of a raw generic vector */
+    template <typename V>
+    using vector_lane = std::remove_cvref_t<decltype(std::declval<V>()[0])>;
+
+    template <typename V>
+    using vector_mask = decltype(std::declval<V>() < std::declval<V>());
+
+    /* x * y + z rounded once, on raw vectors. With hardware_fma the lane loop becomes one fused instruction, except
+     * that GCC vectorizes it in 256-bit halves even on AVX-512, so full 512-bit registers use the intrinsic. */
+    template <typename V>
+    [[nodiscard]] constexpr V fused_multiply_add(const V& x, const V& y, const V& z) {
+#if defined(__AVX512F__)
+        if constexpr (sizeof(V) == 64 && std::is_same_v<vector_lane<V>, float>) {
+            return (V) _mm512_fmadd_ps((__m512) x, (__m512) y, (__m512) z);
+        } else if constexpr (sizeof(V) == 64 && std::is_same_v<vector_lane<V>, double>) {
+            return (V) _mm512_fmadd_pd((__m512d) x, (__m512d) y, (__m512d) z);
+        }
+#endif
+        V result;
+        for (size_t i = 0; i < sizeof(V) / sizeof(vector_lane<V>); ++i) {
+            result[i] = std::fma(x[i], y[i], z[i]);
+        }
+        return result;
+    }
+
+    template <floating T, size_t N>
+    [[nodiscard]] constexpr Packet<T, N> fma(const Packet<T, N>& x, const Packet<T, N>& y, const Packet<T, N>& z) {
+        return {fused_multiply_add(x.v, y.v, z.v)};
+    }
+
+    /* Fallback for operations without a vector form: apply the scalar op lane by lane */
+    template <typename Op, numeric T, size_t N>
+    [[nodiscard]] constexpr auto packet_map(Op op, const Packet<T, N>& x) {
+        Packet<decltype(op(x[0])), N> result;
+        for (size_t i = 0; i < N; ++i) {
+            result.set(i, op(x[i]));
+        }
+        return result;
+    }
+
+    template <typename Op, numeric L, numeric R, size_t N>
+    [[nodiscard]] constexpr auto packet_map(Op op, const Packet<L, N>& x, const Packet<R, N>& y) {
+        Packet<decltype(op(x[0], y[0])), N> result;
+        for (size_t i = 0; i < N; ++i) {
+            result.set(i, op(x[i], y[i]));
+        }
+        return result;
+    }
+} // namespace detail
@@ -0,0 +1,344 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "tensor.h"
+
+
+/* Streaming evaluation, for inputs that do not fit in memory. A Stream is a leaf that holds one block of a longer
+ * sequence at a time; stream_into() evaluates an expression over Stream leaves block by block and hands every block of
+ * the result to a sink, while the next block of every source is read on another thread. */
+
+/* Fills dst with up to count elements and returns how many it wrote; fewer than count means the data has ended */
+template <detail::numeric T>
+using StreamSource = std::function<size_t(T* dst, size_t count)>;
+
+/* Receives count elements of the result; the pointer is only valid during the call */
+template <detail::numeric T>
+using StreamSink = std::function<void(const T* data, size_t count)>;
+
+
+namespace detail {
+    /* The part of a stream that stream_into() drives, whatever its element type. Expression trees hold streams by
+     * const reference; advancing one changes the block they see, so the block state is mutable. */
+    class Chunked {
+    public:
+        virtual ~Chunked() = default;
+
+        /* Reads the next block into the back buffer; may run on another thread than the one evaluating */
+        virtual void prefetch() const = 0;
+
+        /* Makes the prefetched block current and returns its element count */
+        virtual size_t advance() const = 0;
+
+        [[nodiscard]] virtual size_t capacity() const = 0;
+    };
+} // namespace detail
+
+
+/* A leaf whose elements come from a source, one block of the given shape at a time. The last block may be shorter
+ * than the shape; stream_into() then evaluates only its leading elements. With a multi-dimensional block shape,
+ * blocks are whole rows and broadcast against tensors of the row shape. */
+template <detail::numeric T, typename Allocator = AlignedAllocator<T>>
+struct Stream : detail::Expr, detail::Chunked {
+    using element_type = T;
+    using allocator_type = Allocator;
+
+
+    Stream(const Shape& block, StreamSource<T> source, const Allocator& alloc = Allocator())
+        : source(std::move(source)), extents(block), front(block, T{}, alloc), back(block, T{}, alloc) {}
+
+    Stream(size_t block, StreamSource<T> source, const Allocator& alloc = Allocator())
+        : Stream(Shape(block), std::move(source), alloc) {}
+
+    Stream(const Stream&) = delete;
+
+    Stream& operator=(const Stream&) = delete;
+
+    [[nodiscard]] T operator[](size_t i) const {
+        return front[i];
+    }
+
+    template <size_t N>
+    [[nodiscard]] detail::Packet<T, N> packet(size_t i) const {
+        return front.template packet<N>(i);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return extents.size();
+    }
+
+    [[nodiscard]] const Shape& shape() const {
+        return extents;
+    }
+
+    [[nodiscard]] constexpr bool broadcasting() const {
+        return false;
+    }
+
+    [[nodiscard]] const T* data() const {
+        return front.data();
+    }
+
+    /* Elements of the source consumed before the current block */
+    [[nodiscard]] size_t position() const {
+        return consumed;
+    }
+
+    /* Elements of the current block that came from the source */
+    [[nodiscard]] size_t available() const {
+        return front_count;
+    }
+
+    [[nodiscard]] bool aliases(const detail::Footprint& dest) const {
+        return dest.conflicts(front.data(), 1, size());
+    }
+
+    void prefetch() const override {
+        back_count = source(back.data(), size());
+    }
+
+    size_t advance() const override {
+        consumed += front_count;
+        std::swap(front, back);
+        front_count = std::exchange(back_count, 0);
+        return front_count;
+    }
+
+    [[nodiscard]] size_t capacity() const override {
+        return size();
+    }
+
+private:
+    StreamSource<T> source;
+    Shape extents;
+    mutable Tensor<T, Allocator> front;
+    mutable Tensor<T, Allocator> back;
+    mutable size_t front_count = 0;
+    mutable size_t back_count = 0;
+    mutable size_t consumed = 0;
+};
+
+
+namespace detail {
+    template <typename E>
+    void collect_streams(const E& expr, std::vector<const Chunked*>& streams) {
+        if constexpr (std::derived_from<E, Chunked>) {
+            if (std::ranges::find(streams, &expr) == streams.end()) {
+                streams.push_back(&expr);
+            }
+        } else if constexpr (!numeric<E>) {
+            for_each_operand(expr, [&](const auto& operand) { collect_streams(operand, streams); });
+        }
+    }
+
+    /* Every stream has delivered the same number of elements, which is the length of this block of the result */
+    inline size_t advance_all(const std::vector<const Chunked*>& streams) {
+        const size_t count = streams.front()->advance();
+        for (size_t s = 1; s < streams.size(); ++s) {
+            if (streams[s]->advance() != count) {
+                throw std::length_error("stream_into: sources ended at different lengths");
+            }
+        }
+        return count;
+    }
+
+    inline void prefetch_all(const std::vector<const Chunked*>& streams) {
+        for (const Chunked* stream : streams) {
+            stream->prefetch();
+        }
+    }
+} // namespace detail
+
+
+/* Evaluates expr over every block of its Stream leaves and passes each block of the result to sink, reading the next
+ * block of every source while the current one is evaluated. Other leaves are read in full for every block, so they
+ * must have the block's shape or broadcast to it. Returns the number of elements produced.
+ * Throws std::invalid_argument if expr has no Stream leaf or its blocks do not match, and std::length_error if the
+ * sources end at different lengths; exceptions thrown by a source or the sink propagate. */
+template <typename Sink, std::derived_from<detail::Expr> E>
+size_t stream_into(Sink&& sink, const E& expr) {
+    using R = typename E::element_type;
+    static_assert(std::invocable<Sink&, const R*, size_t>, "stream_into: the sink must take (const T*, size_t)");
+
+    std::vector<const detail::Chunked*> streams;
+    detail::collect_streams(expr, streams);
+    if (streams.empty()) {
+        throw std::invalid_argument("stream_into: the expression has no Stream leaf");
+    }
+    const size_t block = streams.front()->capacity();
+    for (const detail::Chunked* stream : streams) {
+        if (stream->capacity() != block) {
+            throw std::invalid_argument("stream_into: streams have different block sizes");
+        }
+    }
+    if (expr.size() != block) {
+        throw std::invalid_argument("stream_into: the expression has shape " + expr.shape().to_string() +
+                                    ", not the block shape of its streams");
+    }
+
+    const auto& simplified = detail::simplify(expr);
+    Tensor<R> result(Shape{block});
+    detail::prefetch_all(streams);
+    size_t total = 0;
+    for (size_t count = detail::advance_all(streams); count > 0; count = detail::advance_all(streams)) {
+        /* A short block is the last one: no source has anything left to prefetch */
+        std::future<void> next;
+        if (count == block) {
+            next = std::async(std::launch::async, [&streams] { detail::prefetch_all(streams); });
+        }
+        if (count < parallel_threshold()) {
+            detail::evaluate(result.data(), simplified, 0, count);
+        } else {
+            detail::thread_pool().parallel_for(count, detail::parallel_grain<R>, [&](size_t first, size_t last) {
+                detail::evaluate(result.data(), simplified, first, last);
+            });
+        }
+        sink(static_cast<const R*>(result.data()), count);
+        total += count;
+        if (!next.valid()) {
+            break;
+        }
+        next.get();
+    }
+    return total;
+}
+
+
+/* Raw elements of T from a binary file, starting offset bytes in. Throws std::system_error if the file cannot be
+ * opened; the source throws it on a read error. */
+template <detail::numeric T>
+[[nodiscard]] StreamSource<T> file_source(const std::string& path, long offset = 0) {
+    std::shared_ptr<std::FILE> file(std::fopen(path.c_str(), "rb"), [](std::FILE* f) {
+        if (f != nullptr) {
+            std::fclose(f);
+        }
+    });
+    if (!file || std::fseek(file.get(), offset, SEEK_SET) != 0) {
+        throw std::system_error(errno, std::generic_category(), "file_source: open " + path);
+    }
+    return [file, path](T* dst, size_t count) {
+        const size_t read = std::fread(dst, sizeof(T), count, file.get());
+        if (read < count && std::ferror(file.get())) {
+            throw std::system_error(errno, std::generic_category(), "file_source: read " + path);
+        }
+        return read;
+    };
+}
+
+/* Elements generate(i) for i in [0, count) */
+template <detail::numeric T, typename F>
+requires std::convertible_to<std::invoke_result_t<F&, size_t>, T>
+[[nodiscard]] StreamSource<T> generator_source(size_t count, F generate) {
+    return [next = size_t{0}, count, generate = std::move(generate)](T* dst, size_t n) mutable {
+        const size_t take = std::min(n, count - next);
+        for (size_t k = 0; k < take; ++k) {
+            dst[k] = static_cast<T>(generate(next + k));
+        }
+        next += take;
+        return take;
+    };
+}
+
+/* Writes the elements to a binary file, replacing its contents. Throws std::system_error if the file cannot be
+ * created; the sink throws it on a write error. */
+template <detail::numeric T>
+[[nodiscard]] StreamSink<T> file_sink(const std::string& path) {
+    std::shared_ptr<std::FILE> file(std::fopen(path.c_str(), "wb"), [](std::FILE* f) {
+        if (f != nullptr) {
+            std::fclose(f);
+        }
+    });
+    if (!file) {
+        throw std::system_error(errno, std::generic_category(), "file_sink: open " + path);
+    }
+    return [file, path](const T* data, size_t count) {
+        if (std::fwrite(data, sizeof(T), count, file.get()) != count || std::fflush(file.get()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "file_sink: write " + path);
+        }
+    };
+}
+
+
+/* Bounded queue from a producer thread to a Stream: push() blocks while the buffer is full, and the source blocks
+ * until a whole block is available or close() has been called. One producer, one consumer. */
+template <detail::numeric T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) : elems(std::max<size_t>(capacity, 1)) {}
+
+    RingBuffer(const RingBuffer&) = delete;
+
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    /* Throws std::logic_error after close() */
+    void push(const T* data, size_t count) {
+        std::unique_lock lock(mutex);
+        if (closed) {
+            throw std::logic_error("RingBuffer: push after close");
+        }
+        while (count > 0) {
+            changed.wait(lock, [&] { return held < elems.size(); });
+            const size_t tail = (head + held) % elems.size();
+            const size_t take = std::min({count, elems.size() - held, elems.size() - tail});
+            std::copy_n(data, take, elems.begin() + static_cast<ptrdiff_t>(tail));
+            held += take;
+            data += take;
+            count -= take;
+            changed.notify_all();
+        }
+    }
+
+    /* No more elements will be pushed; the reader gets what is left, then a short block */
+    void close() {
+        std::lock_guard lock(mutex);
+        closed = true;
+        changed.notify_all();
+    }
+
+    /* Blocks until count elements are available or the buffer is closed; returns how many were copied */
+    size_t read(T* dst, size_t count) {
+        std::unique_lock lock(mutex);
+        size_t copied = 0;
+        while (copied < count) {
+            changed.wait(lock, [&] { return held > 0 || closed; });
+            if (held == 0) {
+                break;
+            }
+            const size_t take = std::min({count - copied, held, elems.size() - head});
+            std::copy_n(elems.begin() + static_cast<ptrdiff_t>(head), take, dst + copied);
+            head = (head + take) % elems.size();
+            held -= take;
+            copied += take;
+            changed.notify_all();
+        }
+        return copied;
+    }
+
+    /* A source reading from this buffer, which must outlive it */
+    [[nodiscard]] StreamSource<T> source() {
+        return [this](T* dst, size_t count) { return read(dst, count); };
+    }
+
+private:
+    std::vector<T> elems;
+    size_t head = 0;
+    size_t held = 0;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
@@ -3,10 +3,37 @@
 
 #include "type_helper.h"
 #include "operator.h"
-
+#include "allocator.h"
+#include "evaluate.h"
+#include "shape.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <initializer_list>
 #include <iostream>
-#include <valarray>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+
+/* Algebraic rewrites applied to an expression tree before it is evaluated; each tier includes the ones before it */
+enum class Rewrite {
+    safe,      /* identities that hold bit for bit for every input, NaN, infinities and signed zeros included */
+    contract,  /* also fuses a multiply into the add or subtract it feeds, rounding once instead of twice */
+    fast_math, /* also identities that need finite, in-domain inputs, such as exp(log(x)) == x */
+};
+
+#if defined(TENSOR_FAST_MATH)
+inline constexpr Rewrite default_rewrite = Rewrite::fast_math;
+#elif defined(TENSOR_STRICT_MATH)
+inline constexpr Rewrite default_rewrite = Rewrite::safe;
+#else
+inline constexpr Rewrite default_rewrite = Rewrite::contract;
+#endif
 
 
 namespace detail {
@@ -19,136 +46,286 @@ namespace detail {
     template <typename L, typename R, typename Op>
     struct BinaryExpr;
 
+    template <typename A, typename B, typename C, typename Op>
+    struct TernaryExpr;
+
+    template <typename E, typename I>
+    struct GatherExpr;
+
+    template <Rewrite Tier = default_rewrite, typename E>
+    constexpr decltype(auto) simplify(const E& expr);
+
+
+    /* Leaves that own their elements (Tensor) are captured by reference; everything else is cheap to copy */
+    template <typename T>
+    concept owning_leaf = requires { typename T::allocator_type; };
+
+    template <typename T>
+    using node_type = std::conditional_t<owning_leaf<T>, const T&, const T>;
+
+
+    /* Memory written by an assignment: element i of the result lands at first + i * step bytes, all within [lo, hi).
+     * A scattered footprint (step 0) gives no such guarantee to the reader. */
+    struct Footprint {
+        const std::byte* lo;
+        const std::byte* hi;
+        const std::byte* first;
+        ptrdiff_t step;
+
+        template <numeric T>
+        [[nodiscard]] static Footprint of(const T* base, ptrdiff_t stride, size_t count) {
+            const auto* first = reinterpret_cast<const std::byte*>(base);
+            const ptrdiff_t step = stride * static_cast<ptrdiff_t>(sizeof(T));
+            const ptrdiff_t span = count > 0 ? static_cast<ptrdiff_t>(count - 1) * step : 0;
+            const auto* lo = span < 0 ? first + span : first;
+            const auto* hi = (span < 0 ? first : first + span) + (count > 0 ? sizeof(T) : 0);
+            return {lo, hi, first, step};
+        }
+
+        [[nodiscard]] Footprint scattered() const {
+            return {lo, hi, first, 0};
+        }
+
+        /* Whether a leaf reading element i from base[i * stride] could see a value already overwritten: it overlaps
+         * the footprint and does not read exactly the element that is being written at the same index */
+        template <numeric T>
+        [[nodiscard]] bool conflicts(const T* base, ptrdiff_t stride, size_t count) const {
+            const Footprint read = of(base, stride, count);
+            if (read.lo >= hi || lo >= read.hi) {
+                return false;
+            }
+            return step == 0 || read.first != first || read.step != step;
+        }
+    };
+
 
     struct Expr {
         template <typename Self>
         [[nodiscard]] constexpr bool any(this const Self& self) {
-            for (size_t i = 0; i < self.size(); ++i) {
-                if (self[i]) {
-                    return true;
+            if consteval {
+                for (size_t i = 0; i < self.size(); ++i) {
+                    if (self[i]) {
+                        return true;
+                    }
                 }
+                return false;
+            } else {
+                return contains<true>(simplify(self));
             }
-            return false;
         }
 
         template <typename Self>
         [[nodiscard]] constexpr bool all(this const Self& self) {
-            for (size_t i = 0; i < self.size(); ++i) {
-                if (!self[i]) {
-                    return false;
+            if consteval {
+                for (size_t i = 0; i < self.size(); ++i) {
+                    if (!self[i]) {
+                        return false;
+                    }
                 }
+                return true;
+            } else {
+                return !contains<false>(simplify(self));
             }
-            return true;
         }
 
-        template <numeric T, typename Self>
-        [[nodiscard]] constexpr auto cast(this const Self& self) {
-            return CastExpr<T, Self>{self};
+        template <Summation S = Summation::pairwise, typename Self>
+        [[nodiscard]] constexpr auto sum(this const Self& self) {
+            return reduce_sum<S>(simplify(self));
         }
 
         template <typename Self>
-        requires integral<typename Self::element_type>
-        [[nodiscard]] constexpr auto operator~(this const Self& self) {
-            return UnaryExpr{self, ComplOp{}};
+        [[nodiscard]] constexpr auto prod(this const Self& self) {
+            return reduce_with<accumulator_type<typename Self::element_type>>(simplify(self), MulOp{});
         }
 
+        /* Smallest element, skipping NaNs as std::fmin does; an expression of nothing but NaNs gives infinity */
         template <typename Self>
-        [[nodiscard]] constexpr auto operator+(this const Self& self) {
-            return self;
+        [[nodiscard]] constexpr auto min(this const Self& self) {
+            using T = typename Self::element_type;
+            return static_cast<T>(reduce_with<compute_type<T>>(simplify(self), MinOp{}));
         }
 
+        /* Largest element, skipping NaNs as std::fmax does; an expression of nothing but NaNs gives -infinity */
         template <typename Self>
-        [[nodiscard]] constexpr auto operator-(this const Self& self) {
-            return UnaryExpr{self, NegOp{}};
+        [[nodiscard]] constexpr auto max(this const Self& self) {
+            using T = typename Self::element_type;
+            return static_cast<T>(reduce_with<compute_type<T>>(simplify(self), MaxOp{}));
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto abs(this const Self& self) {
-            return UnaryExpr{self, AbsOp{}};
+        template <Summation S = Summation::pairwise, typename Self>
+        [[nodiscard]] constexpr auto mean(this const Self& self) {
+            using A = accumulator_type<typename Self::element_type>;
+            using R = std::conditional_t<floating<A>, A, double>;
+            return static_cast<R>(self.template sum<S>()) / static_cast<R>(self.size());
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto sqrt(this const Self& self) {
-            return UnaryExpr{self, SqrtOp{}};
+        template <Summation S = Summation::pairwise, typename Self, typename R>
+        requires std::derived_from<R, Expr>
+        [[nodiscard]] constexpr auto dot(this const Self& self, const R& rhs) {
+            using A = accumulator_type<common_type_t<typename Self::element_type, typename R::element_type>>;
+            return (self.template cast<A>() * rhs.template cast<A>()).template sum<S>();
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto exp(this const Self& self) {
-            return UnaryExpr{self, ExpOp{}};
+        template <Summation S = Summation::pairwise, typename Self>
+        [[nodiscard]] constexpr auto norm(this const Self& self) {
+            using F = to_floating<typename Self::element_type>;
+            const auto x = self.template cast<F>();
+            return std::sqrt((x * x).template sum<S>());
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto log(this const Self& self) {
-            return UnaryExpr{self, LogOp{}};
+        template <numeric T, typename Self>
+        [[nodiscard]] constexpr auto cast(this Self&& self) {
+            return CastExpr<T, std::remove_cvref_t<Self>>{std::forward<Self>(self)};
         }
 
         template <typename Self>
-        [[nodiscard]] constexpr auto sin(this const Self& self) {
-            return UnaryExpr{self, SinOp{}};
+        requires integral<typename std::remove_cvref_t<Self>::element_type>
+        [[nodiscard]] constexpr auto operator~(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), ComplOp{}};
         }
 
+        /* A named tensor comes back by reference so that +t can still be captured by an expression */
         template <typename Self>
-        [[nodiscard]] constexpr auto cos(this const Self& self) {
-            return UnaryExpr{self, CosOp{}};
+        [[nodiscard]] constexpr decltype(auto) operator+(this Self&& self) {
+            using E = std::remove_cvref_t<Self>;
+            if constexpr (owning_leaf<E> && std::is_lvalue_reference_v<Self>) {
+                return static_cast<const E&>(self);
+            } else {
+                return E(std::forward<Self>(self));
+            }
         }
 
         template <typename Self>
-        [[nodiscard]] constexpr auto tan(this const Self& self) {
-            return UnaryExpr{self, TanOp{}};
+        [[nodiscard]] constexpr auto operator-(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), NegOp{}};
         }
 
         template <typename Self>
-        [[nodiscard]] constexpr auto asin(this const Self& self) {
-            return UnaryExpr{self, AsinOp{}};
+        [[nodiscard]] constexpr auto abs(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), AbsOp{}};
         }
 
         template <typename Self>
-        [[nodiscard]] constexpr auto acos(this const Self& self) {
-            return UnaryExpr{self, AcosOp{}};
+        [[nodiscard]] constexpr auto sqrt(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), SqrtOp{}};
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto atan(this const Self& self) {
-            return UnaryExpr{self, AtanOp{}};
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto exp(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), ExpOp<A>{}};
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto sinh(this const Self& self) {
-            return UnaryExpr{self, SinhOp{}};
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto log(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), LogOp<A>{}};
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto cosh(this const Self& self) {
-            return UnaryExpr{self, CoshOp{}};
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto log10(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), Log10Op<A>{}};
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto tanh(this const Self& self) {
-            return UnaryExpr{self, TanhOp{}};
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto sin(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), SinOp<A>{}};
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto asinh(this const Self& self) {
-            return UnaryExpr{self, AsinhOp{}};
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto cos(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), CosOp<A>{}};
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto acosh(this const Self& self) {
-            return UnaryExpr{self, AcoshOp{}};
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto tan(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), TanOp<A>{}};
         }
 
-        template <typename Self>
-        [[nodiscard]] constexpr auto atanh(this const Self& self) {
-            return UnaryExpr{self, AtanhOp{}};
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto asin(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), AsinOp<A>{}};
+        }
+
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto acos(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), AcosOp<A>{}};
+        }
+
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto atan(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), AtanOp<A>{}};
+        }
+
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto sinh(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), SinhOp<A>{}};
+        }
+
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto cosh(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), CoshOp<A>{}};
         }
 
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto tanh(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), TanhOp<A>{}};
+        }
+
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto asinh(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), AsinhOp<A>{}};
+        }
+
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto acosh(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), AcoshOp<A>{}};
+        }
+
+        template <Accuracy A = default_accuracy, typename Self>
+        [[nodiscard]] constexpr auto atanh(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), AtanhOp<A>{}};
+        }
+
+        /* A scalar exponent is analyzed once, here, rather than per element */
         template <typename Self, typename R>
-        requires std::derived_from<R, Expr> || numeric<R>
-        [[nodiscard]] constexpr auto pow(this const Self& self, const R& rhs) {
-            return BinaryExpr{self, rhs, PowOp{}};
+        requires std::derived_from<std::remove_cvref_t<R>, Expr> || numeric<std::remove_cvref_t<R>>
+        [[nodiscard]] constexpr auto pow(this Self&& self, R&& rhs) {
+            if constexpr (numeric<std::remove_cvref_t<R>>) {
+                return UnaryExpr{std::forward<Self>(self), ScalarPowOp<compute_type<std::remove_cvref_t<R>>>{rhs}};
+            } else {
+                return BinaryExpr{std::forward<Self>(self), std::forward<R>(rhs), PowOp{}};
+            }
+        }
+
+        /* self^N as a chain of multiplications fixed at compile time */
+        template <int N, typename Self>
+        [[nodiscard]] constexpr auto pow(this Self&& self) {
+            return UnaryExpr{std::forward<Self>(self), ConstPowOp<N>{}};
+        }
+
+        /* Element i is self[index[i]]; the result takes the shape of index */
+        template <typename Self, typename I>
+        requires std::derived_from<std::remove_cvref_t<I>, Expr> &&
+                 integral<typename std::remove_cvref_t<I>::element_type>
+        [[nodiscard]] constexpr auto gather(this Self&& self, I&& index) {
+            return GatherExpr{std::forward<Self>(self), std::forward<I>(index)};
+        }
+
+        /* The tree that evaluation runs, after simplify(): one line per node with its element type, shape and the
+         * promotions it applies to its operands, then estimated flops, bytes moved, flops per byte and the code path */
+        template <typename Self>
+        [[nodiscard]] std::string explain(this const Self& self) {
+            return describe(simplify(self));
         }
     };
 
+    template <typename T>
+    concept expression = std::derived_from<std::remove_cvref_t<T>, Expr>;
+
+
+    [[nodiscard]] inline std::string explain(const std::derived_from<Expr> auto& expr) {
+        return expr.explain();
+    }
+
     [[nodiscard]] constexpr auto any(const std::derived_from<Expr> auto& expr) {
         return expr.any();
     }
@@ -157,68 +334,104 @@ namespace detail {
         return expr.all();
     }
 
-    [[nodiscard]] constexpr auto abs(const std::derived_from<Expr> auto& expr) {
-        return expr.abs();
+    template <Summation S = Summation::pairwise>
+    [[nodiscard]] constexpr auto sum(const std::derived_from<Expr> auto& expr) {
+        return expr.template sum<S>();
+    }
+
+    [[nodiscard]] constexpr auto prod(const std::derived_from<Expr> auto& expr) {
+        return expr.prod();
+    }
+
+    [[nodiscard]] constexpr auto min(const std::derived_from<Expr> auto& expr) {
+        return expr.min();
+    }
+
+    [[nodiscard]] constexpr auto max(const std::derived_from<Expr> auto& expr) {
+        return expr.max();
+    }
+
+    template <Summation S = Summation::pairwise>
+    [[nodiscard]] constexpr auto mean(const std::derived_from<Expr> auto& expr) {
+        return expr.template mean<S>();
+    }
+
+    template <Summation S = Summation::pairwise>
+    [[nodiscard]] constexpr auto dot(const std::derived_from<Expr> auto& lhs, const std::derived_from<Expr> auto& rhs) {
+        return lhs.template dot<S>(rhs);
     }
 
-    [[nodiscard]] constexpr auto sqrt(const std::derived_from<Expr> auto& expr) {
-        return expr.sqrt();
+    template <Summation S = Summation::pairwise>
+    [[nodiscard]] constexpr auto norm(const std::derived_from<Expr> auto& expr) {
+        return expr.template norm<S>();
     }
 
-    [[nodiscard]] constexpr auto exp(const std::derived_from<Expr> auto& expr) {
-        return expr.exp();
+    [[nodiscard]] constexpr auto abs(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).abs();
     }
 
-    [[nodiscard]] constexpr auto log(const std::derived_from<Expr> auto& expr) {
-        return expr.log();
+    [[nodiscard]] constexpr auto sqrt(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).sqrt();
     }
 
-    [[nodiscard]] constexpr auto sin(const std::derived_from<Expr> auto& expr) {
-        return expr.sin();
+    [[nodiscard]] constexpr auto exp(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).exp();
     }
 
-    [[nodiscard]] constexpr auto cos(const std::derived_from<Expr> auto& expr) {
-        return expr.cos();
+    [[nodiscard]] constexpr auto log(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).log();
     }
 
-    [[nodiscard]] constexpr auto tan(const std::derived_from<Expr> auto& expr) {
-        return expr.tan();
+    [[nodiscard]] constexpr auto sin(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).sin();
     }
 
-    [[nodiscard]] constexpr auto asin(const std::derived_from<Expr> auto& expr) {
-        return expr.asin();
+    [[nodiscard]] constexpr auto cos(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).cos();
     }
 
-    [[nodiscard]] constexpr auto acos(const std::derived_from<Expr> auto& expr) {
-        return expr.acos();
+    [[nodiscard]] constexpr auto tan(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).tan();
     }
 
-    [[nodiscard]] constexpr auto atan(const std::derived_from<Expr> auto& expr) {
-        return expr.atan();
+    [[nodiscard]] constexpr auto asin(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).asin();
     }
 
-    [[nodiscard]] constexpr auto sinh(const std::derived_from<Expr> auto& expr) {
-        return expr.sinh();
+    [[nodiscard]] constexpr auto acos(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).acos();
     }
 
-    [[nodiscard]] constexpr auto cosh(const std::derived_from<Expr> auto& expr) {
-        return expr.cosh();
+    [[nodiscard]] constexpr auto atan(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).atan();
     }
 
-    [[nodiscard]] constexpr auto tanh(const std::derived_from<Expr> auto& expr) {
-        return expr.tanh();
+    [[nodiscard]] constexpr auto sinh(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).sinh();
     }
 
-    [[nodiscard]] constexpr auto asinh(const std::derived_from<Expr> auto& expr) {
-        return expr.asinh();
+    [[nodiscard]] constexpr auto cosh(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).cosh();
     }
 
-    [[nodiscard]] constexpr auto acosh(const std::derived_from<Expr> auto& expr) {
-        return expr.acosh();
+    [[nodiscard]] constexpr auto tanh(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).tanh();
     }
 
-    [[nodiscard]] constexpr auto atanh(const std::derived_from<Expr> auto& expr) {
-        return expr.atanh();
+    [[nodiscard]] constexpr auto asinh(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).asinh();
+    }
+
+    [[nodiscard]] constexpr auto acosh(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).acosh();
+    }
+
+    [[nodiscard]] constexpr auto atanh(expression auto&& expr) {
+        return std::forward<decltype(expr)>(expr).atanh();
+    }
+
+    [[nodiscard]] constexpr auto gather(expression auto&& source, expression auto&& index) {
+        return std::forward<decltype(source)>(source).gather(std::forward<decltype(index)>(index));
     }
 
 
@@ -228,21 +441,21 @@ namespace detail {
                                  integral<L> && std::derived_from<R, Expr> && integral<typename R::element_type>;
 
     template <typename L, typename R>
-    requires bitwise_compatible<L, R>
-    [[nodiscard]] constexpr auto operator&(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, AndOp{}};
+    requires bitwise_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator&(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), AndOp{}};
     }
 
     template <typename L, typename R>
-    requires bitwise_compatible<L, R>
-    [[nodiscard]] constexpr auto operator|(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, OrOp{}};
+    requires bitwise_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator|(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), OrOp{}};
     }
 
     template <typename L, typename R>
-    requires bitwise_compatible<L, R>
-    [[nodiscard]] constexpr auto operator^(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, XorOp{}};
+    requires bitwise_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator^(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), XorOp{}};
     }
 
 
@@ -251,77 +464,126 @@ namespace detail {
                                 numeric<L> && std::derived_from<R, Expr>;
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator==(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, EqOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator==(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), EqOp{}};
     }
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator!=(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, NeOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator!=(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), NeOp{}};
     }
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator<(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, LtOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator<(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), LtOp{}};
     }
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator<=(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, LeOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator<=(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), LeOp{}};
     }
 
     template <typename L, typename R>
-    requires std::derived_from<L, Expr> && (std::derived_from<R, Expr> || numeric<R>) ||
-             numeric<L> && std::derived_from<R, Expr>
-    [[nodiscard]] constexpr auto operator>(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, GtOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator>(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), GtOp{}};
     }
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator>=(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, GeOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator>=(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), GeOp{}};
     }
 
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator+(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, AddOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator+(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), AddOp{}};
     }
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator-(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, SubOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator-(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), SubOp{}};
     }
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator*(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, MulOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator*(L&& lhs, R&& rhs) {
+        return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), MulOp{}};
     }
 
+    /* An integral expression over an integral scalar, whose division is prepared once rather than done per element */
+    template <typename L, typename R>
+    concept scalar_divisor = std::derived_from<L, Expr> && integral<typename L::element_type> && integral<R>;
+
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator/(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, DivOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator/(L&& lhs, R&& rhs) {
+        using E = std::remove_cvref_t<L>;
+        if constexpr (scalar_divisor<E, std::remove_cvref_t<R>>) {
+            return UnaryExpr{std::forward<L>(lhs), ScalarDivOp<typename E::element_type, std::remove_cvref_t<R>>{rhs}};
+        } else {
+            return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), DivOp{}};
+        }
     }
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto operator%(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, ModOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto operator%(L&& lhs, R&& rhs) {
+        using E = std::remove_cvref_t<L>;
+        if constexpr (scalar_divisor<E, std::remove_cvref_t<R>>) {
+            return UnaryExpr{std::forward<L>(lhs), ScalarModOp<typename E::element_type, std::remove_cvref_t<R>>{rhs}};
+        } else {
+            return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), ModOp{}};
+        }
     }
 
     template <typename L, typename R>
-    requires binary_compatible<L, R>
-    [[nodiscard]] constexpr auto pow(const L& lhs, const R& rhs) {
-        return BinaryExpr{lhs, rhs, PowOp{}};
+    requires binary_compatible<std::remove_cvref_t<L>, std::remove_cvref_t<R>>
+    [[nodiscard]] constexpr auto pow(L&& lhs, R&& rhs) {
+        if constexpr (numeric<std::remove_cvref_t<L>>) {
+            return BinaryExpr{std::forward<L>(lhs), std::forward<R>(rhs), PowOp{}};
+        } else {
+            return std::forward<L>(lhs).pow(std::forward<R>(rhs));
+        }
+    }
+
+    template <int N, typename E>
+    requires std::derived_from<std::remove_cvref_t<E>, Expr>
+    [[nodiscard]] constexpr auto pow(E&& expr) {
+        return std::forward<E>(expr).template pow<N>();
+    }
+
+
+    template <typename C, typename A, typename B>
+    concept select_compatible = std::derived_from<C, Expr> && (std::derived_from<A, Expr> || numeric<A>) &&
+                                (std::derived_from<B, Expr> || numeric<B>);
+
+    /* Elementwise cond ? a : b over the broadcast shape of all three, in the common type of a and b. Both branches
+     * are evaluated at every index and blended, so a branch that would trap (integer division by zero) cannot be
+     * guarded by the condition alone. */
+    template <typename C, typename A, typename B>
+    requires select_compatible<std::remove_cvref_t<C>, std::remove_cvref_t<A>, std::remove_cvref_t<B>>
+    [[nodiscard]] constexpr auto where(C&& cond, A&& a, B&& b) {
+        return TernaryExpr{std::forward<C>(cond), std::forward<A>(a), std::forward<B>(b), SelectOp{}};
+    }
+
+    /* value as elements of T, the way assignment to a tensor of T would convert it */
+    template <numeric T, typename R>
+    [[nodiscard]] constexpr decltype(auto) converted(const R& value) {
+        if constexpr (numeric<R>) {
+            return static_cast<T>(value);
+        } else if constexpr (std::is_same_v<typename R::element_type, T>) {
+            return value;
+        } else {
+            return value.template cast<T>();
+        }
     }
 
 
@@ -332,16 +594,40 @@ namespace detail {
 
         explicit constexpr CastExpr(const E& expr) : expr(expr) {}
 
+        /* Capturing a temporary Tensor by reference would dangle once the full-expression ends */
+        explicit CastExpr(E&& expr) requires owning_leaf<E> = delete;
+
         [[nodiscard]] constexpr auto operator[](size_t i) const {
             return static_cast<T>(expr[i]);
         }
 
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<T, N> packet(size_t i) const {
+            return expr.template packet<N>(i).template as<T>();
+        }
+
         [[nodiscard]] constexpr size_t size() const {
             return expr.size();
         }
 
+        [[nodiscard]] constexpr Shape shape() const {
+            return expr.shape();
+        }
+
+        [[nodiscard]] constexpr bool broadcasting() const {
+            return expr.broadcasting();
+        }
+
+        [[nodiscard]] constexpr bool aliases(const Footprint& dest) const {
+            return expr.aliases(dest);
+        }
+
+        [[nodiscard]] constexpr const E& operand() const {
+            return expr;
+        }
+
     private:
-        const E& expr;
+        node_type<E> expr;
     };
 
     template <typename E, typename Op>
@@ -351,16 +637,43 @@ namespace detail {
 
         constexpr UnaryExpr(const E& expr, Op op) : expr(expr), op(op) {}
 
+        UnaryExpr(E&& expr, Op op) requires owning_leaf<E> = delete;
+
         [[nodiscard]] constexpr auto operator[](size_t i) const {
             return op(expr[i]);
         }
 
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<element_type, N> packet(size_t i) const {
+            return op(expr.template packet<N>(i));
+        }
+
         [[nodiscard]] constexpr size_t size() const {
             return expr.size();
         }
 
+        [[nodiscard]] constexpr Shape shape() const {
+            return expr.shape();
+        }
+
+        [[nodiscard]] constexpr bool broadcasting() const {
+            return expr.broadcasting();
+        }
+
+        [[nodiscard]] constexpr bool aliases(const Footprint& dest) const {
+            return expr.aliases(dest);
+        }
+
+        [[nodiscard]] constexpr const E& operand() const {
+            return expr;
+        }
+
+        [[nodiscard]] constexpr Op operation() const {
+            return op;
+        }
+
     private:
-        const E& expr;
+        node_type<E> expr;
         [[no_unique_address]] Op op;
     };
 
@@ -369,76 +682,688 @@ namespace detail {
         using element_type = typename operator_result<Op, L, R>::type;
 
 
-        constexpr BinaryExpr(const L& lhs, const R& rhs, Op op) : lhs(lhs), rhs(rhs), op(op) {}
+        /* Throws std::invalid_argument if the operand shapes cannot be broadcast together */
+        constexpr BinaryExpr(const L& lhs, const R& rhs, Op op)
+            : lhs(lhs), rhs(rhs), op(op), extents(Shape::broadcast(shape_of(lhs), shape_of(rhs))),
+              lhs_map(shape_of(lhs), extents), rhs_map(shape_of(rhs), extents) {}
+
+        BinaryExpr(L&& lhs, const R& rhs, Op op) requires owning_leaf<L> = delete;
+
+        BinaryExpr(const L& lhs, R&& rhs, Op op) requires owning_leaf<R> = delete;
 
         [[nodiscard]] constexpr auto operator[](size_t i) const {
             if constexpr (numeric<L>) {
-                return op(lhs, rhs[i]);
+                return op(lhs, rhs[rhs_map(i)]);
             } else {
                 if constexpr (numeric<R>) {
-                    return op(lhs[i], rhs);
+                    return op(lhs[lhs_map(i)], rhs);
                 } else {
-                    return op(lhs[i], rhs[i]);
+                    return op(lhs[lhs_map(i)], rhs[rhs_map(i)]);
+                }
+            }
+        }
+
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<element_type, N> packet(size_t i) const {
+            if constexpr (numeric<L>) {
+                return op(Packet<L, N>::broadcast(lhs), rhs_map.template packet<N>(rhs, i));
+            } else {
+                if constexpr (numeric<R>) {
+                    return op(lhs_map.template packet<N>(lhs, i), Packet<R, N>::broadcast(rhs));
+                } else {
+                    return op(lhs_map.template packet<N>(lhs, i), rhs_map.template packet<N>(rhs, i));
                 }
             }
         }
 
         [[nodiscard]] constexpr size_t size() const {
+            return extents.size();
+        }
+
+        [[nodiscard]] constexpr Shape shape() const {
+            return extents;
+        }
+
+        [[nodiscard]] constexpr bool broadcasting() const {
             if constexpr (numeric<L>) {
-                return rhs.size();
+                return !rhs_map.identity() || rhs.broadcasting();
             } else {
-                return lhs.size();
+                if constexpr (numeric<R>) {
+                    return !lhs_map.identity() || lhs.broadcasting();
+                } else {
+                    return !lhs_map.identity() || !rhs_map.identity() || lhs.broadcasting() || rhs.broadcasting();
+                }
             }
         }
 
-    private:
-        template <typename T>
-        using node_type = std::conditional_t<numeric<T>, const T, const T&>;
+        /* A broadcast operand is read at other indices than the one being written */
+        [[nodiscard]] constexpr bool aliases(const Footprint& dest) const {
+            const auto read = [&](const auto& operand, const BroadcastMap& map) {
+                return operand.aliases(map.identity() ? dest : dest.scattered());
+            };
+            if constexpr (numeric<L>) {
+                return read(rhs, rhs_map);
+            } else {
+                if constexpr (numeric<R>) {
+                    return read(lhs, lhs_map);
+                } else {
+                    return read(lhs, lhs_map) || read(rhs, rhs_map);
+                }
+            }
+        }
 
+        [[nodiscard]] constexpr const L& left() const {
+            return lhs;
+        }
+
+        [[nodiscard]] constexpr const R& right() const {
+            return rhs;
+        }
+
+        [[nodiscard]] constexpr Op operation() const {
+            return op;
+        }
+
+    private:
         node_type<L> lhs;
         node_type<R> rhs;
         [[no_unique_address]] Op op;
+        Shape extents;
+        BroadcastMap lhs_map;
+        BroadcastMap rhs_map;
+    };
+
+    template <typename A, typename B, typename C, typename Op>
+    struct TernaryExpr : Expr {
+        using element_type = typename operator_result<Op, A, B, C>::type;
+
+
+        /* Throws std::invalid_argument if the operand shapes cannot be broadcast together */
+        constexpr TernaryExpr(const A& a, const B& b, const C& c, Op op)
+            : a(a), b(b), c(c), op(op),
+              extents(Shape::broadcast(Shape::broadcast(shape_of(a), shape_of(b)), shape_of(c))),
+              a_map(shape_of(a), extents), b_map(shape_of(b), extents), c_map(shape_of(c), extents) {}
+
+        TernaryExpr(A&& a, const B& b, const C& c, Op op) requires owning_leaf<A> = delete;
+
+        TernaryExpr(const A& a, B&& b, const C& c, Op op) requires owning_leaf<B> = delete;
+
+        TernaryExpr(const A& a, const B& b, C&& c, Op op) requires owning_leaf<C> = delete;
+
+        [[nodiscard]] constexpr auto operator[](size_t i) const {
+            return op(at(a, a_map, i), at(b, b_map, i), at(c, c_map, i));
+        }
+
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<element_type, N> packet(size_t i) const {
+            return op(packet_at<N>(a, a_map, i), packet_at<N>(b, b_map, i), packet_at<N>(c, c_map, i));
+        }
+
+        [[nodiscard]] constexpr size_t size() const {
+            return extents.size();
+        }
+
+        [[nodiscard]] constexpr Shape shape() const {
+            return extents;
+        }
+
+        [[nodiscard]] constexpr bool broadcasting() const {
+            return operand_broadcasts(a, a_map) || operand_broadcasts(b, b_map) || operand_broadcasts(c, c_map);
+        }
+
+        [[nodiscard]] constexpr bool aliases(const Footprint& dest) const {
+            return operand_aliases(a, a_map, dest) || operand_aliases(b, b_map, dest) ||
+                   operand_aliases(c, c_map, dest);
+        }
+
+        [[nodiscard]] constexpr const A& first() const {
+            return a;
+        }
+
+        [[nodiscard]] constexpr const B& second() const {
+            return b;
+        }
+
+        [[nodiscard]] constexpr const C& third() const {
+            return c;
+        }
+
+        [[nodiscard]] constexpr Op operation() const {
+            return op;
+        }
+
+    private:
+        /* Scalar operands are the same at every index */
+        template <typename X>
+        [[nodiscard]] static constexpr auto at(const X& x, const BroadcastMap& map, size_t i) {
+            if constexpr (numeric<X>) {
+                return x;
+            } else {
+                return x[map(i)];
+            }
+        }
+
+        template <size_t N, typename X>
+        [[nodiscard]] static constexpr auto packet_at(const X& x, const BroadcastMap& map, size_t i) {
+            if constexpr (numeric<X>) {
+                return Packet<X, N>::broadcast(x);
+            } else {
+                return map.template packet<N>(x, i);
+            }
+        }
+
+        template <typename X>
+        [[nodiscard]] static constexpr bool operand_broadcasts(const X& x, const BroadcastMap& map) {
+            if constexpr (numeric<X>) {
+                return false;
+            } else {
+                return !map.identity() || x.broadcasting();
+            }
+        }
+
+        template <typename X>
+        [[nodiscard]] static constexpr bool operand_aliases(const X& x, const BroadcastMap& map,
+                                                            const Footprint& dest) {
+            if constexpr (numeric<X>) {
+                return false;
+            } else {
+                return x.aliases(map.identity() ? dest : dest.scattered());
+            }
+        }
+
+        node_type<A> a;
+        node_type<B> b;
+        node_type<C> c;
+        [[no_unique_address]] Op op;
+        Shape extents;
+        BroadcastMap a_map;
+        BroadcastMap b_map;
+        BroadcastMap c_map;
     };
+
+    template <typename E, typename I>
+    struct GatherExpr : Expr {
+        using element_type = typename E::element_type;
+
+
+        constexpr GatherExpr(const E& source, const I& index) : source(source), index(index) {}
+
+        GatherExpr(E&& source, const I& index) requires owning_leaf<E> = delete;
+
+        GatherExpr(const E& source, I&& index) requires owning_leaf<I> = delete;
+
+        [[nodiscard]] constexpr auto operator[](size_t i) const {
+            const auto at = static_cast<size_t>(index[i]);
+            assert(at < source.size());
+            return source[at];
+        }
+
+        /* Indices come in as a packet, elements are fetched lane by lane */
+        template <size_t N>
+        [[nodiscard]] constexpr Packet<element_type, N> packet(size_t i) const {
+            const auto at = index.template packet<N>(i);
+            Packet<element_type, N> result;
+            for (size_t k = 0; k < N; ++k) {
+                assert(static_cast<size_t>(at[k]) < source.size());
+                result.set(k, source[static_cast<size_t>(at[k])]);
+            }
+            return result;
+        }
+
+        [[nodiscard]] constexpr size_t size() const {
+            return index.size();
+        }
+
+        [[nodiscard]] constexpr Shape shape() const {
+            return index.shape();
+        }
+
+        [[nodiscard]] constexpr bool broadcasting() const {
+            return index.broadcasting();
+        }
+
+        [[nodiscard]] constexpr bool aliases(const Footprint& dest) const {
+            return source.aliases(dest.scattered()) || index.aliases(dest);
+        }
+
+        [[nodiscard]] constexpr const E& gathered() const {
+            return source;
+        }
+
+        [[nodiscard]] constexpr const I& indices() const {
+            return index;
+        }
+
+    private:
+        node_type<E> source;
+        node_type<I> index;
+    };
+
+
+    /* Rewriting. simplify() walks the node types and returns an equivalent, cheaper tree; subtrees that no rule
+     * touches are returned as they are, so an expression without redundancy costs nothing to simplify.
+     *
+     * Rewrite::safe
+     *     -(-x) -> x            ~~x -> x                     abs(abs(x)) -> abs(x)        abs(-x) -> abs(x)
+     *     x - (-y) -> x + y     x + (-y) -> x - y (when the result type is unchanged, except bool)
+     *     x.cast<T>() -> x when x is already T
+     *     x.cast<U>().cast<T>() -> x.cast<T>() when U holds every value of x exactly
+     * Rewrite::contract, in addition, with hardware FMA and a floating-point product of the result type
+     *     x * y + z -> fma(x, y, z)     z + x * y -> fma(x, y, z)
+     *     x * y - z -> fms(x, y, z)     z - x * y -> fnma(x, y, z)
+     *     where any of x, y, z may be a scalar (alpha * x + y is an axpy)
+     * Rewrite::fast_math, in addition
+     *     exp(log(x)) -> x      log(exp(x)) -> x
+     *
+     * A rewrite that changes the element type is wrapped in a cast back to the original one. Rules that depend on
+     * the value of a scalar operand (x * 1, x + 0) or on two operands being the same tensor (sqrt(x) * sqrt(x))
+     * cannot be decided from types and are not applied. */
+    template <typename E, typename Op>
+    inline constexpr bool is_unary = false;
+
+    template <typename E, typename Op>
+    inline constexpr bool is_unary<UnaryExpr<E, Op>, Op> = true;
+
+    template <typename E, template <Accuracy> typename Family>
+    inline constexpr bool is_unary_tier = false;
+
+    template <typename E, typename Op, template <Accuracy> typename Family>
+    inline constexpr bool is_unary_tier<UnaryExpr<E, Op>, Family> = is_tier_of<Op, Family>;
+
+    /* A multiply whose own result is already of type T, so fusing it changes only the rounding */
+    template <typename E, typename T>
+    inline constexpr bool is_product = false;
+
+    template <typename L, typename R, typename T>
+    inline constexpr bool is_product<BinaryExpr<L, R, MulOp>, T> =
+        std::is_same_v<typename BinaryExpr<L, R, MulOp>::element_type, T>;
+
+    template <typename E>
+    inline constexpr bool is_cast = false;
+
+    template <numeric T, typename E>
+    inline constexpr bool is_cast<CastExpr<T, E>> = true;
+
+    /* Whether every value of From converts to To and back unchanged */
+    template <numeric From, numeric To>
+    [[nodiscard]] consteval bool lossless() {
+        using F = std::numeric_limits<From>;
+        using T = std::numeric_limits<To>;
+        if constexpr (std::is_same_v<From, To> || std::is_same_v<From, bool>) {
+            return true;
+        } else if constexpr (std::is_same_v<To, bool>) {
+            return false;
+        } else if constexpr (floating<compute_type<From>>) {
+            return floating<compute_type<To>> && T::digits >= F::digits && T::max_exponent >= F::max_exponent;
+        } else if constexpr (floating<compute_type<To>>) {
+            return T::digits >= F::digits;
+        } else {
+            return std::cmp_less_equal(T::min(), F::min()) && std::cmp_greater_equal(T::max(), F::max());
+        }
+    }
+
+    /* Owning leaves stay references; everything else is copied out of the tree being rebuilt */
+    template <numeric T, typename E>
+    [[nodiscard]] constexpr decltype(auto) rewritten(const E& expr) {
+        if constexpr (!std::is_same_v<typename E::element_type, T>) {
+            return CastExpr<T, E>{expr};
+        } else if constexpr (owning_leaf<E>) {
+            return expr;
+        } else {
+            return E(expr);
+        }
+    }
+
+    template <Rewrite Tier, typename E>
+    constexpr decltype(auto) simplify(const E& expr) {
+        return expr;
+    }
+
+    template <Rewrite Tier = default_rewrite, numeric T, typename E>
+    constexpr decltype(auto) simplify(const CastExpr<T, E>& expr) {
+        decltype(auto) inner = simplify<Tier>(expr.operand());
+        using I = std::remove_cvref_t<decltype(inner)>;
+        if constexpr (std::is_same_v<typename I::element_type, T>) {
+            return rewritten<T>(inner);
+        } else if constexpr (is_cast<I>) {
+            using U = typename I::element_type;
+            using X = std::remove_cvref_t<decltype(inner.operand())>;
+            if constexpr (lossless<typename X::element_type, U>()) {
+                return rewritten<T>(inner.operand());
+            } else {
+                return CastExpr<T, I>{inner};
+            }
+        } else if constexpr (std::is_same_v<I, E>) {
+            return expr;
+        } else {
+            return CastExpr<T, I>{inner};
+        }
+    }
+
+    template <Rewrite Tier = default_rewrite, typename E, typename Op>
+    constexpr decltype(auto) simplify(const UnaryExpr<E, Op>& expr) {
+        using T = typename UnaryExpr<E, Op>::element_type;
+        decltype(auto) inner = simplify<Tier>(expr.operand());
+        using I = std::remove_cvref_t<decltype(inner)>;
+        constexpr bool involution = (std::is_same_v<Op, NegOp> && is_unary<I, NegOp>) ||
+                                    (std::is_same_v<Op, ComplOp> && is_unary<I, ComplOp>);
+        constexpr bool inverse = Tier == Rewrite::fast_math && ((is_tier_of<Op, ExpOp> && is_unary_tier<I, LogOp>) ||
+                                                                (is_tier_of<Op, LogOp> && is_unary_tier<I, ExpOp>));
+        if constexpr (involution || inverse) {
+            return rewritten<T>(inner.operand());
+        } else if constexpr (std::is_same_v<Op, AbsOp> && is_unary<I, AbsOp>) {
+            return rewritten<T>(inner);
+        } else if constexpr (std::is_same_v<Op, AbsOp> && is_unary<I, NegOp>) {
+            const UnaryExpr positive{inner.operand(), AbsOp{}};
+            return rewritten<T>(simplify<Tier>(positive));
+        } else if constexpr (std::is_same_v<I, E>) {
+            return expr;
+        } else {
+            return UnaryExpr{inner, expr.operation()};
+        }
+    }
+
+    template <Rewrite Tier = default_rewrite, typename L, typename R, typename Op>
+    constexpr decltype(auto) simplify(const BinaryExpr<L, R, Op>& expr) {
+        using T = typename BinaryExpr<L, R, Op>::element_type;
+        decltype(auto) lhs = simplify<Tier>(expr.left());
+        decltype(auto) rhs = simplify<Tier>(expr.right());
+        using SL = std::remove_cvref_t<decltype(lhs)>;
+        using SR = std::remove_cvref_t<decltype(rhs)>;
+        constexpr bool additive = std::is_same_v<Op, AddOp> || std::is_same_v<Op, SubOp>;
+        constexpr bool contract = Tier >= Rewrite::contract && hardware_fma && floating<T> && additive;
+        if constexpr (additive && is_unary<SR, NegOp>) {
+            using Y = std::remove_cvref_t<decltype(rhs.operand())>;
+            using Flipped = BinaryExpr<SL, Y, std::conditional_t<std::is_same_v<Op, AddOp>, SubOp, AddOp>>;
+            if constexpr (std::is_same_v<typename Flipped::element_type, T> &&
+                          !std::is_same_v<typename Y::element_type, bool>) {
+                const Flipped flipped{lhs, rhs.operand(), {}};
+                return rewritten<T>(simplify<Tier>(flipped));
+            } else {
+                return BinaryExpr<SL, SR, Op>{lhs, rhs, expr.operation()};
+            }
+        } else if constexpr (contract && is_product<SL, T>) {
+            using Fused = std::conditional_t<std::is_same_v<Op, AddOp>, FmaOp, FmsOp>;
+            return TernaryExpr{lhs.left(), lhs.right(), rhs, Fused{}};
+        } else if constexpr (contract && is_product<SR, T>) {
+            using Fused = std::conditional_t<std::is_same_v<Op, AddOp>, FmaOp, FnmaOp>;
+            return TernaryExpr{rhs.left(), rhs.right(), lhs, Fused{}};
+        } else if constexpr (std::is_same_v<SL, L> && std::is_same_v<SR, R>) {
+            return expr;
+        } else {
+            return BinaryExpr<SL, SR, Op>{lhs, rhs, expr.operation()};
+        }
+    }
+
+    template <Rewrite Tier = default_rewrite, typename A, typename B, typename C, typename Op>
+    constexpr decltype(auto) simplify(const TernaryExpr<A, B, C, Op>& expr) {
+        decltype(auto) a = simplify<Tier>(expr.first());
+        decltype(auto) b = simplify<Tier>(expr.second());
+        decltype(auto) c = simplify<Tier>(expr.third());
+        using SA = std::remove_cvref_t<decltype(a)>;
+        using SB = std::remove_cvref_t<decltype(b)>;
+        using SC = std::remove_cvref_t<decltype(c)>;
+        if constexpr (std::is_same_v<SA, A> && std::is_same_v<SB, B> && std::is_same_v<SC, C>) {
+            return expr;
+        } else {
+            return TernaryExpr<SA, SB, SC, Op>{a, b, c, expr.operation()};
+        }
+    }
+
+    template <Rewrite Tier = default_rewrite, typename E, typename I>
+    constexpr decltype(auto) simplify(const GatherExpr<E, I>& expr) {
+        decltype(auto) source = simplify<Tier>(expr.gathered());
+        decltype(auto) index = simplify<Tier>(expr.indices());
+        using SE = std::remove_cvref_t<decltype(source)>;
+        using SI = std::remove_cvref_t<decltype(index)>;
+        if constexpr (std::is_same_v<SE, E> && std::is_same_v<SI, I>) {
+            return expr;
+        } else {
+            return GatherExpr<SE, SI>{source, index};
+        }
+    }
 } // namespace detail
 
 
 template <detail::numeric T>
+struct StridedView;
+
+
+template <detail::numeric T, typename Allocator = AlignedAllocator<T>>
 struct Tensor : detail::Expr {
     using element_type = T;
+    using allocator_type = Allocator;
 
 
-    Tensor(T value, size_t count) : elems(value, count) {}
+    Tensor(T value, size_t count, const Allocator& alloc = Allocator()) : Tensor(uninitialized, Shape(count), alloc) {
+        std::fill_n(elems, count, value);
+    }
 
-    Tensor(T* buffer, size_t count) : elems(buffer, count) {}
+    Tensor(const Shape& shape, T value = T{}, const Allocator& alloc = Allocator())
+        : Tensor(uninitialized, shape, alloc) {
+        std::fill_n(elems, count, value);
+    }
+
+    Tensor(T* buffer, size_t count, const Allocator& alloc = Allocator()) : Tensor(uninitialized, Shape(count), alloc) {
+        std::copy_n(buffer, count, elems);
+    }
 
     template <size_t N>
-    explicit Tensor(const T (& arr)[N]) : elems(arr, N) {}
+    explicit Tensor(const T (& arr)[N], const Allocator& alloc = Allocator()) : Tensor(uninitialized, Shape(N), alloc) {
+        std::copy_n(arr, N, elems);
+    }
 
-    Tensor(std::initializer_list<T> il) : elems(il) {}
+    Tensor(std::initializer_list<T> il, const Allocator& alloc = Allocator())
+        : Tensor(uninitialized, Shape(il.size()), alloc) {
+        std::ranges::copy(il, elems);
+    }
+
+    Tensor(const std::derived_from<Expr> auto& expr, const Allocator& alloc = Allocator())
+        : Tensor(uninitialized, expr.shape(), alloc) {
+        detail::evaluate(elems, detail::simplify(expr));
+    }
+
+    Tensor(const Tensor& other)
+        : Tensor(uninitialized, other.extents,
+                 std::allocator_traits<Allocator>::select_on_container_copy_construction(other.alloc)) {
+        std::copy_n(other.elems, count, elems);
+    }
+
+    Tensor(Tensor&& other) noexcept
+        : elems(std::exchange(other.elems, nullptr)), count(std::exchange(other.count, 0)),
+          extents(std::exchange(other.extents, Shape(0))), alloc(other.alloc) {}
+
+    ~Tensor() {
+        release();
+    }
 
-    Tensor(const std::derived_from<Expr> auto& expr) : elems(expr.size()) {
-        for (size_t i = 0; i < size(); ++i) {
-            elems[i] = expr[i];
+    Tensor& operator=(const Tensor& other) {
+        if (this != &other) {
+            resize(other.extents);
+            std::copy_n(other.elems, count, elems);
         }
+        return *this;
+    }
+
+    Tensor& operator=(Tensor&& other) noexcept(std::allocator_traits<Allocator>::is_always_equal::value) {
+        if (alloc == other.alloc) {
+            std::swap(elems, other.elems);
+            std::swap(count, other.count);
+            std::swap(extents, other.extents);
+        } else {
+            *this = other;
+        }
+        return *this;
     }
 
     Tensor& operator=(T value) {
-        elems = value;
+        std::fill_n(elems, count, value);
         return *this;
     }
 
     Tensor& operator=(std::initializer_list<T> il) {
-        elems = il;
+        resize(Shape(il.size()));
+        std::ranges::copy(il, elems);
+        return *this;
+    }
+
+    template <std::derived_from<Expr> E>
+    Tensor& operator=(const E& expr) {
+        return assign(expr);
+    }
+
+    /* Evaluates into the existing storage, going through a temporary only when the shape changes
+     * or the expression reads this tensor at positions other than the one being written */
+    template <std::derived_from<Expr> E>
+    Tensor& assign(const E& expr) {
+        if (expr.shape() != extents || expr.aliases(detail::Footprint::of(elems, 1, count))) {
+            Tensor result(expr, alloc);
+            std::swap(elems, result.elems);
+            std::swap(count, result.count);
+            std::swap(extents, result.extents);
+        } else {
+            detail::evaluate(elems, detail::simplify(expr));
+        }
         return *this;
     }
 
+    template <typename R>
+    requires requires (const Tensor& t, const R& r) { t + r; }
+    Tensor& operator+=(const R& rhs) {
+        return assign(*this + rhs);
+    }
+
+    template <typename R>
+    requires requires (const Tensor& t, const R& r) { t - r; }
+    Tensor& operator-=(const R& rhs) {
+        return assign(*this - rhs);
+    }
+
+    template <typename R>
+    requires requires (const Tensor& t, const R& r) { t * r; }
+    Tensor& operator*=(const R& rhs) {
+        return assign(*this * rhs);
+    }
+
+    template <typename R>
+    requires requires (const Tensor& t, const R& r) { t / r; }
+    Tensor& operator/=(const R& rhs) {
+        return assign(*this / rhs);
+    }
+
+    template <typename R>
+    requires requires (const Tensor& t, const R& r) { t % r; }
+    Tensor& operator%=(const R& rhs) {
+        return assign(*this % rhs);
+    }
+
+    template <typename R>
+    requires requires (const Tensor& t, const R& r) { t & r; }
+    Tensor& operator&=(const R& rhs) {
+        return assign(*this & rhs);
+    }
+
+    template <typename R>
+    requires requires (const Tensor& t, const R& r) { t | r; }
+    Tensor& operator|=(const R& rhs) {
+        return assign(*this | rhs);
+    }
+
+    template <typename R>
+    requires requires (const Tensor& t, const R& r) { t ^ r; }
+    Tensor& operator^=(const R& rhs) {
+        return assign(*this ^ rhs);
+    }
+
+    /* Assigns value only where mask is true, leaving the other elements as they are. mask and value broadcast to
+     * this tensor's shape, which does not change; throws std::invalid_argument if they do not. */
+    template <std::derived_from<Expr> M, typename R>
+    requires std::derived_from<R, Expr> || detail::numeric<R>
+    Tensor& masked_assign(const M& mask, const R& value) {
+        const auto selected = where(mask, detail::converted<T>(value), *this);
+        if (selected.shape() != extents) {
+            throw std::invalid_argument("Tensor: cannot masked_assign " + selected.shape().to_string() + " to " +
+                                        extents.to_string());
+        }
+        return assign(selected);
+    }
+
     template <typename Self>
     [[nodiscard]] T operator[](this Self&& self, size_t i) {
         return std::forward<Self>(self).elems[i];
     }
 
+    /* Element at a multi-dimensional index, one coordinate per dimension */
+    template <std::convertible_to<size_t>... Index>
+    [[nodiscard]] T operator()(Index... index) const {
+        assert(sizeof...(Index) == extents.rank());
+        size_t offset = 0;
+        size_t d = 0;
+        ((offset = offset * extents[d++] + static_cast<size_t>(index)), ...);
+        return elems[offset];
+    }
+
+    template <size_t N>
+    [[nodiscard]] detail::Packet<T, N> packet(size_t i) const {
+        return detail::Packet<T, N>::load(elems + i);
+    }
+
     [[nodiscard]] size_t size() const {
-        return elems.size();
+        return count;
+    }
+
+    [[nodiscard]] const Shape& shape() const {
+        return extents;
+    }
+
+    [[nodiscard]] std::array<size_t, Shape::max_rank> strides() const {
+        return extents.strides();
+    }
+
+    /* Reinterprets the elements under a new shape of the same size; throws std::invalid_argument otherwise */
+    Tensor& reshape(const Shape& shape) {
+        if (shape.size() != count) {
+            throw std::invalid_argument("Tensor: cannot reshape " + extents.to_string() + " to " + shape.to_string());
+        }
+        extents = shape;
+        return *this;
+    }
+
+    [[nodiscard]] constexpr bool broadcasting() const {
+        return false;
+    }
+
+    /* Views over the flattened elements share this tensor's storage and must not outlive it */
+    [[nodiscard]] StridedView<T> slice(size_t begin, size_t end, size_t step = 1) {
+        return StridedView<T>(elems, count).slice(begin, end, step);
+    }
+
+    [[nodiscard]] StridedView<const T> slice(size_t begin, size_t end, size_t step = 1) const {
+        return StridedView<const T>(elems, count).slice(begin, end, step);
+    }
+
+    [[nodiscard]] StridedView<T> reversed() {
+        return StridedView<T>(elems, count).reversed();
+    }
+
+    [[nodiscard]] StridedView<const T> reversed() const {
+        return StridedView<const T>(elems, count).reversed();
+    }
+
+    [[nodiscard]] T* data() {
+        return elems;
+    }
+
+    [[nodiscard]] const T* data() const {
+        return elems;
+    }
+
+    [[nodiscard]] Allocator get_allocator() const {
+        return alloc;
+    }
+
+    [[nodiscard]] constexpr bool aliases(const detail::Footprint& dest) const {
+        return dest.conflicts(elems, 1, count);
     }
 
     friend std::ostream& operator<<(std::ostream& os, const Tensor& t) {
@@ -465,10 +1390,388 @@ struct Tensor : detail::Expr {
     }
 
 private:
-    std::valarray<T> elems;
+    struct uninitialized_t {};
+
+    static constexpr uninitialized_t uninitialized{};
+
+    /* Elements are numeric, so storage needs no construction before it is first written */
+    Tensor(uninitialized_t, const Shape& shape, const Allocator& alloc)
+        : count(shape.size()), extents(shape), alloc(alloc) {
+        if (count > 0) {
+            elems = std::allocator_traits<Allocator>::allocate(this->alloc, count);
+        }
+    }
+
+    void release() {
+        if (elems != nullptr) {
+            std::allocator_traits<Allocator>::deallocate(alloc, elems, count);
+            elems = nullptr;
+        }
+    }
+
+    /* Contents are unspecified afterwards unless the size was unchanged */
+    void resize(const Shape& shape) {
+        extents = shape;
+        if (shape.size() != count) {
+            release();
+            count = shape.size();
+            if (count > 0) {
+                elems = std::allocator_traits<Allocator>::allocate(alloc, count);
+            }
+        }
+    }
+
+    T* elems = nullptr;
+    size_t count = 0;
+    Shape extents;
+    [[no_unique_address]] Allocator alloc;
 };
 
 
 template <std::derived_from<detail::Expr> E>
 Tensor(E) -> Tensor<typename E::element_type>;
 
+
+/* Non-owning window onto count elements spaced stride apart; a negative stride walks backwards.
+ * Views of non-const elements are assignment targets: assigning writes through to the viewed storage. */
+template <detail::numeric T>
+struct StridedView : detail::Expr {
+    using element_type = std::remove_const_t<T>;
+
+
+    constexpr StridedView(T* base, size_t count, ptrdiff_t stride = 1) : base(base), count(count), stride(stride) {}
+
+    constexpr StridedView(const StridedView& other) = default;
+
+    /* Copies elements, not the view, as std::slice_array does */
+    StridedView& operator=(const StridedView& other) requires (!std::is_const_v<T>) {
+        return assign(other);
+    }
+
+    StridedView& operator=(element_type value) requires (!std::is_const_v<T>) {
+        for (size_t i = 0; i < count; ++i) {
+            base[static_cast<ptrdiff_t>(i) * stride] = value;
+        }
+        return *this;
+    }
+
+    template <std::derived_from<Expr> E>
+    requires (!std::is_const_v<T>)
+    StridedView& operator=(const E& expr) {
+        return assign(expr);
+    }
+
+    /* Throws std::invalid_argument when the sizes differ; a view cannot be resized */
+    template <std::derived_from<Expr> E>
+    requires (!std::is_const_v<T>)
+    StridedView& assign(const E& expr) {
+        if (expr.size() != count) {
+            throw std::invalid_argument("StridedView: cannot assign " + std::to_string(expr.size()) +
+                                        " elements to a view of " + std::to_string(count));
+        }
+        if (expr.aliases(detail::Footprint::of(base, stride, count))) {
+            const Tensor<element_type> result(expr);
+            detail::evaluate_strided(base, stride, result);
+        } else {
+            detail::evaluate_strided(base, stride, detail::simplify(expr));
+        }
+        return *this;
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const StridedView& v, const R& r) { v + r; }
+    StridedView& operator+=(const R& rhs) {
+        return assign(*this + rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const StridedView& v, const R& r) { v - r; }
+    StridedView& operator-=(const R& rhs) {
+        return assign(*this - rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const StridedView& v, const R& r) { v * r; }
+    StridedView& operator*=(const R& rhs) {
+        return assign(*this * rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const StridedView& v, const R& r) { v / r; }
+    StridedView& operator/=(const R& rhs) {
+        return assign(*this / rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const StridedView& v, const R& r) { v % r; }
+    StridedView& operator%=(const R& rhs) {
+        return assign(*this % rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const StridedView& v, const R& r) { v & r; }
+    StridedView& operator&=(const R& rhs) {
+        return assign(*this & rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const StridedView& v, const R& r) { v | r; }
+    StridedView& operator|=(const R& rhs) {
+        return assign(*this | rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const StridedView& v, const R& r) { v ^ r; }
+    StridedView& operator^=(const R& rhs) {
+        return assign(*this ^ rhs);
+    }
+
+    /* As Tensor::masked_assign; throws std::invalid_argument unless mask and value broadcast to the view's shape */
+    template <std::derived_from<Expr> M, typename R>
+    requires (!std::is_const_v<T>) && (std::derived_from<R, Expr> || detail::numeric<R>)
+    StridedView& masked_assign(const M& mask, const R& value) {
+        const auto selected = where(mask, detail::converted<element_type>(value), *this);
+        if (selected.shape() != shape()) {
+            throw std::invalid_argument("StridedView: cannot masked_assign " + selected.shape().to_string() + " to " +
+                                        shape().to_string());
+        }
+        return assign(selected);
+    }
+
+    [[nodiscard]] constexpr element_type operator[](size_t i) const {
+        return base[static_cast<ptrdiff_t>(i) * stride];
+    }
+
+    template <size_t N>
+    [[nodiscard]] detail::Packet<element_type, N> packet(size_t i) const {
+        using P = detail::Packet<element_type, N>;
+        if (stride == 1) {
+            return P::load(base + i);
+        }
+        if (stride == -1) {
+            return P::load(base - static_cast<ptrdiff_t>(i + N - 1)).reverse();
+        }
+        P result;
+        for (size_t k = 0; k < N; ++k) {
+            result.set(k, (*this)[i + k]);
+        }
+        return result;
+    }
+
+    [[nodiscard]] constexpr size_t size() const {
+        return count;
+    }
+
+    [[nodiscard]] constexpr Shape shape() const {
+        return Shape(count);
+    }
+
+    [[nodiscard]] constexpr bool broadcasting() const {
+        return false;
+    }
+
+    /* Every step-th element of [begin, end), counted along this view */
+    [[nodiscard]] constexpr StridedView slice(size_t begin, size_t end, size_t step = 1) const {
+        assert(begin <= end && end <= count && step > 0);
+        const ptrdiff_t offset = static_cast<ptrdiff_t>(begin) * stride;
+        return StridedView(base + offset, (end - begin + step - 1) / step, stride * static_cast<ptrdiff_t>(step));
+    }
+
+    [[nodiscard]] constexpr StridedView reversed() const {
+        const ptrdiff_t offset = count > 0 ? static_cast<ptrdiff_t>(count - 1) * stride : 0;
+        return StridedView(base + offset, count, -stride);
+    }
+
+    [[nodiscard]] constexpr bool aliases(const detail::Footprint& dest) const {
+        return dest.conflicts(base, stride, count);
+    }
+
+private:
+    T* base;
+    size_t count;
+    ptrdiff_t stride;
+};
+
+
+/* Non-owning, contiguous, shaped leaf over caller-owned memory, such as a buffer from another library or an mmap'ed
+ * file; TensorView<const T> is read-only. The memory must stay valid, and keep its contents, while the view is used. */
+template <detail::numeric T>
+struct TensorView : detail::Expr {
+    using element_type = std::remove_const_t<T>;
+
+
+    constexpr TensorView(T* data, size_t count) : elems(data), extents(count) {}
+
+    constexpr TensorView(T* data, const Shape& shape) : elems(data), extents(shape) {}
+
+    template <typename A>
+    requires std::is_const_v<T>
+    TensorView(const Tensor<element_type, A>& tensor) : elems(tensor.data()), extents(tensor.shape()) {}
+
+    template <typename A>
+    TensorView(Tensor<element_type, A>& tensor) : elems(tensor.data()), extents(tensor.shape()) {}
+
+    constexpr TensorView(const TensorView& other) = default;
+
+    /* Copies elements, not the view */
+    TensorView& operator=(const TensorView& other) requires (!std::is_const_v<T>) {
+        return assign(other);
+    }
+
+    TensorView& operator=(element_type value) requires (!std::is_const_v<T>) {
+        std::fill_n(elems, size(), value);
+        return *this;
+    }
+
+    template <std::derived_from<Expr> E>
+    requires (!std::is_const_v<T>)
+    TensorView& operator=(const E& expr) {
+        return assign(expr);
+    }
+
+    /* Throws std::invalid_argument when the sizes differ; the viewed memory cannot be resized */
+    template <std::derived_from<Expr> E>
+    requires (!std::is_const_v<T>)
+    TensorView& assign(const E& expr) {
+        if (expr.size() != size()) {
+            throw std::invalid_argument("TensorView: cannot assign " + expr.shape().to_string() + " to " +
+                                        extents.to_string());
+        }
+        if (expr.aliases(detail::Footprint::of(elems, 1, size()))) {
+            const Tensor<element_type> result(expr);
+            detail::evaluate(elems, result);
+        } else {
+            detail::evaluate(elems, detail::simplify(expr));
+        }
+        return *this;
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const TensorView& v, const R& r) { v + r; }
+    TensorView& operator+=(const R& rhs) {
+        return assign(*this + rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const TensorView& v, const R& r) { v - r; }
+    TensorView& operator-=(const R& rhs) {
+        return assign(*this - rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const TensorView& v, const R& r) { v * r; }
+    TensorView& operator*=(const R& rhs) {
+        return assign(*this * rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const TensorView& v, const R& r) { v / r; }
+    TensorView& operator/=(const R& rhs) {
+        return assign(*this / rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const TensorView& v, const R& r) { v % r; }
+    TensorView& operator%=(const R& rhs) {
+        return assign(*this % rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const TensorView& v, const R& r) { v & r; }
+    TensorView& operator&=(const R& rhs) {
+        return assign(*this & rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const TensorView& v, const R& r) { v | r; }
+    TensorView& operator|=(const R& rhs) {
+        return assign(*this | rhs);
+    }
+
+    template <typename R>
+    requires (!std::is_const_v<T>) && requires (const TensorView& v, const R& r) { v ^ r; }
+    TensorView& operator^=(const R& rhs) {
+        return assign(*this ^ rhs);
+    }
+
+    /* As Tensor::masked_assign; throws std::invalid_argument unless mask and value broadcast to the view's shape */
+    template <std::derived_from<Expr> M, typename R>
+    requires (!std::is_const_v<T>) && (std::derived_from<R, Expr> || detail::numeric<R>)
+    TensorView& masked_assign(const M& mask, const R& value) {
+        const auto selected = where(mask, detail::converted<element_type>(value), *this);
+        if (selected.shape() != extents) {
+            throw std::invalid_argument("TensorView: cannot masked_assign " + selected.shape().to_string() + " to " +
+                                        extents.to_string());
+        }
+        return assign(selected);
+    }
+
+    [[nodiscard]] constexpr element_type operator[](size_t i) const {
+        return elems[i];
+    }
+
+    template <size_t N>
+    [[nodiscard]] detail::Packet<element_type, N> packet(size_t i) const {
+        return detail::Packet<element_type, N>::load(elems + i);
+    }
+
+    [[nodiscard]] constexpr size_t size() const {
+        return extents.size();
+    }
+
+    [[nodiscard]] constexpr const Shape& shape() const {
+        return extents;
+    }
+
+    [[nodiscard]] constexpr bool broadcasting() const {
+        return false;
+    }
+
+    /* Throws std::invalid_argument if the new shape has a different size */
+    TensorView& reshape(const Shape& shape) {
+        if (shape.size() != size()) {
+            throw std::invalid_argument("TensorView: cannot reshape " + extents.to_string() + " to " +
+                                        shape.to_string());
+        }
+        extents = shape;
+        return *this;
+    }
+
+    [[nodiscard]] constexpr StridedView<T> slice(size_t begin, size_t end, size_t step = 1) const {
+        return StridedView<T>(elems, size()).slice(begin, end, step);
+    }
+
+    [[nodiscard]] constexpr StridedView<T> reversed() const {
+        return StridedView<T>(elems, size()).reversed();
+    }
+
+    [[nodiscard]] constexpr T* data() const {
+        return elems;
+    }
+
+    [[nodiscard]] constexpr bool aliases(const detail::Footprint& dest) const {
+        return dest.conflicts(elems, 1, size());
+    }
+
+private:
+    T* elems;
+    Shape extents;
+};
+
+template <typename T, typename A>
+TensorView(Tensor<T, A>&) -> TensorView<T>;
+
+template <typename T, typename A>
+TensorView(const Tensor<T, A>&) -> TensorView<const T>;
+
+
+template <detail::numeric T, typename A, std::derived_from<detail::Expr> E>
+Tensor<T, A>& eval_into(Tensor<T, A>& out, const E& expr) {
+    return out.assign(expr);
+}
+
+template <detail::numeric T, std::derived_from<detail::Expr> E>
+TensorView<T> eval_into(TensorView<T> out, const E& expr) {
+    return out.assign(expr);
+}
+
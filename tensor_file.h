@@ -0,0 +1,473 @@
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "mapped_file.h"
+#include "tensor.h"
+
+
+/* Binary tensor files: a fixed header followed by the raw elements in native byte order, starting at an aligned
+ * offset so that a mapping of the file can be used in place. Layout of version 1, all fields native-endian:
+ *
+ *   offset  size  field
+ *        0     8  magic "TENSOR\0\n"
+ *        8     4  version
+ *       12     2  byte order mark 0x0102
+ *       14     1  element type, an ElementType
+ *       15     1  flags; bit 0 set when the checksum field is valid
+ *       16     8  data offset, a multiple of the alignment the file was written with
+ *       24     8  element count
+ *       32     8  XXH64 (seed 0) of the data bytes
+ *       40     8  rank
+ *       48    64  extents, outermost first; unused ones are 0
+ *
+ * The header is written last, so a file whose writer did not finish has no magic and is rejected on load. */
+
+enum class ElementType : uint8_t {
+    boolean = 1, int8, int16, int32, int64, uint8, uint16, uint32, uint64, float32, float64, float16, bfloat16
+};
+
+struct TensorFileOptions {
+    size_t alignment = 64; /* of the data offset; a power of two, raised to the element alignment if smaller */
+    bool checksum = true;
+};
+
+
+namespace detail {
+    template <numeric T>
+    [[nodiscard]] constexpr ElementType element_type_of() {
+        using U = std::remove_cv_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            return ElementType::boolean;
+        } else if constexpr (floating<U>) {
+            return sizeof(U) == 4 ? ElementType::float32 : ElementType::float64;
+        } else if constexpr (half_floating<U>) {
+            return std::is_same_v<U, float16> ? ElementType::float16 : ElementType::bfloat16;
+        } else if constexpr (signed_integral<U>) {
+            return sizeof(U) == 1 ? ElementType::int8 : sizeof(U) == 2 ? ElementType::int16
+                                 : sizeof(U) == 4 ? ElementType::int32 : ElementType::int64;
+        } else {
+            return sizeof(U) == 1 ? ElementType::uint8 : sizeof(U) == 2 ? ElementType::uint16
+                                 : sizeof(U) == 4 ? ElementType::uint32 : ElementType::uint64;
+        }
+    }
+
+    struct ElementInfo {
+        std::string_view name;
+        size_t size = 0;
+    };
+
+    /* Indexed by ElementType; entry 0 marks an unknown code */
+    inline constexpr std::array<ElementInfo, 14> element_infos{{
+        {},
+        {type_name<bool>(), sizeof(bool)},
+        {type_name<int8_t>(), 1},
+        {type_name<int16_t>(), 2},
+        {type_name<int32_t>(), 4},
+        {type_name<int64_t>(), 8},
+        {type_name<uint8_t>(), 1},
+        {type_name<uint16_t>(), 2},
+        {type_name<uint32_t>(), 4},
+        {type_name<uint64_t>(), 8},
+        {type_name<float>(), sizeof(float)},
+        {type_name<double>(), sizeof(double)},
+        {type_name<float16>(), sizeof(float16)},
+        {type_name<bfloat16>(), sizeof(bfloat16)},
+    }};
+
+    [[nodiscard]] constexpr ElementInfo element_info(uint8_t code) {
+        return code < element_infos.size() ? element_infos[code] : ElementInfo{};
+    }
+
+
+    struct FileHeader {
+        static constexpr std::array<char, 8> signature{'T', 'E', 'N', 'S', 'O', 'R', '\0', '\n'};
+        static constexpr uint32_t current_version = 1;
+        static constexpr uint16_t byte_order_mark = 0x0102;
+        static constexpr uint8_t has_checksum = 1;
+
+        std::array<char, 8> magic{};
+        uint32_t version = 0;
+        uint16_t byte_order = 0;
+        uint8_t type = 0;
+        uint8_t flags = 0;
+        uint64_t data_offset = 0;
+        uint64_t count = 0;
+        uint64_t checksum = 0;
+        uint64_t rank = 0;
+        std::array<uint64_t, Shape::max_rank> extents{};
+    };
+
+    static_assert(std::is_trivially_copyable_v<FileHeader> && sizeof(FileHeader) == 112);
+
+
+    /* Incremental XXH64 with seed 0, so files can be checked with standard tools. Four independent lanes over 32-byte
+     * stripes, which runs at memory speed; input that does not fill a stripe waits in a small buffer. */
+    class Checksum {
+    public:
+        void update(const void* data, size_t bytes) {
+            auto src = static_cast<const std::byte*>(data);
+            total += bytes;
+            if (buffered + bytes < stripe) {
+                std::memcpy(buffer.data() + buffered, src, bytes);
+                buffered += bytes;
+                return;
+            }
+            if (buffered > 0) {
+                const size_t fill = stripe - buffered;
+                std::memcpy(buffer.data() + buffered, src, fill);
+                consume(buffer.data());
+                src += fill;
+                bytes -= fill;
+                buffered = 0;
+            }
+            for (; bytes >= stripe; src += stripe, bytes -= stripe) {
+                consume(src);
+            }
+            std::memcpy(buffer.data(), src, bytes);
+            buffered = bytes;
+        }
+
+        [[nodiscard]] uint64_t digest() const {
+            uint64_t h = prime5;
+            if (total >= stripe) {
+                h = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+                for (const uint64_t lane : lanes) {
+                    h = (h ^ round(0, lane)) * prime1 + prime4;
+                }
+            }
+            h += total;
+            const std::byte* p = buffer.data();
+            size_t left = buffered;
+            for (; left >= 8; p += 8, left -= 8) {
+                h = std::rotl(h ^ round(0, read<uint64_t>(p)), 27) * prime1 + prime4;
+            }
+            if (left >= 4) {
+                h = std::rotl(h ^ read<uint32_t>(p) * prime1, 23) * prime2 + prime3;
+                p += 4;
+                left -= 4;
+            }
+            for (; left > 0; ++p, --left) {
+                h = std::rotl(h ^ static_cast<uint8_t>(*p) * prime5, 11) * prime1;
+            }
+            h = (h ^ h >> 33) * prime2;
+            h = (h ^ h >> 29) * prime3;
+            return h ^ h >> 32;
+        }
+
+    private:
+        static constexpr uint64_t prime1 = 0x9E3779B185EBCA87;
+        static constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4F;
+        static constexpr uint64_t prime3 = 0x165667B19E3779F9;
+        static constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63;
+        static constexpr uint64_t prime5 = 0x27D4EB2F165667C5;
+        static constexpr size_t stripe = 32;
+
+        template <typename U>
+        static U read(const std::byte* p) {
+            U value;
+            std::memcpy(&value, p, sizeof(U));
+            return value;
+        }
+
+        static constexpr uint64_t round(uint64_t lane, uint64_t input) {
+            return std::rotl(lane + input * prime2, 31) * prime1;
+        }
+
+        void consume(const std::byte* p) {
+            for (size_t k = 0; k < 4; ++k) {
+                lanes[k] = round(lanes[k], read<uint64_t>(p + 8 * k));
+            }
+        }
+
+        std::array<uint64_t, 4> lanes{prime1 + prime2, prime2, 0, 0 - prime1};
+        std::array<std::byte, stripe> buffer{};
+        size_t buffered = 0;
+        uint64_t total = 0;
+    };
+
+
+    template <typename E>
+    constexpr bool contiguous_leaf = false;
+
+    template <typename T, typename A>
+    constexpr bool contiguous_leaf<Tensor<T, A>> = true;
+
+    template <typename T>
+    constexpr bool contiguous_leaf<TensorView<T>> = true;
+
+    /* Elements evaluated per block by save(): one block is written while the next is computed */
+    template <numeric T>
+    inline constexpr size_t save_block = (size_t{4} << 20) / sizeof(T);
+} // namespace detail
+
+
+/* Writes a tensor file from blocks of elements, e.g. as the sink of stream_into(). Without a shape the tensor is
+ * one-dimensional and as long as what was written. The file is complete once close() returns; a writer destroyed
+ * before that leaves a file that TensorFile rejects. Errors throw std::system_error. */
+template <detail::numeric T>
+class TensorWriter {
+public:
+    TensorWriter(const std::string& path, const Shape& shape, const TensorFileOptions& options = {})
+        : TensorWriter(path, options) {
+        expected = shape;
+    }
+
+    explicit TensorWriter(const std::string& path, const TensorFileOptions& options = {})
+        : file(open(path, options)), path(path), checksummed(options.checksum) {
+        if (!file) {
+            throw std::system_error(errno, std::generic_category(), "TensorWriter: open " + path);
+        }
+        const size_t alignment = std::max(options.alignment, alignof(T));
+        data_offset = (sizeof(detail::FileHeader) + alignment - 1) / alignment * alignment;
+        /* Placeholder without a magic until close() */
+        const std::string zeros(data_offset, '\0');
+        if (std::fwrite(zeros.data(), 1, zeros.size(), file.get()) != zeros.size()) {
+            throw std::system_error(errno, std::generic_category(), "TensorWriter: write " + path);
+        }
+    }
+
+    TensorWriter(TensorWriter&&) noexcept = default;
+
+    TensorWriter& operator=(TensorWriter&&) noexcept = default;
+
+    /* Appends count elements; throws std::logic_error after close() */
+    void write(const T* data, size_t count) {
+        if (!file) {
+            throw std::logic_error("TensorWriter: write after close");
+        }
+        if (count == 0) {
+            return;
+        }
+        if (std::fwrite(data, sizeof(T), count, file.get()) != count) {
+            throw std::system_error(errno, std::generic_category(), "TensorWriter: write " + path);
+        }
+        if (checksummed) {
+            hash.update(data, count * sizeof(T));
+        }
+        elements += count;
+    }
+
+    void operator()(const T* data, size_t count) {
+        write(data, count);
+    }
+
+    /* Writes the header and closes the file. Throws std::length_error if a shape was given and a different number of
+     * elements was written, leaving the file incomplete. */
+    void close() {
+        if (!file) {
+            return;
+        }
+        if (expected && expected->size() != elements) {
+            file.reset();
+            throw std::length_error("TensorWriter: wrote " + std::to_string(elements) + " elements of shape " +
+                                    expected->to_string());
+        }
+        const Shape shape = expected.value_or(Shape(elements));
+        detail::FileHeader header;
+        header.magic = detail::FileHeader::signature;
+        header.version = detail::FileHeader::current_version;
+        header.byte_order = detail::FileHeader::byte_order_mark;
+        header.type = static_cast<uint8_t>(detail::element_type_of<T>());
+        header.flags = checksummed ? detail::FileHeader::has_checksum : 0;
+        header.data_offset = data_offset;
+        header.count = elements;
+        header.checksum = checksummed ? hash.digest() : 0;
+        header.rank = shape.rank();
+        std::ranges::copy(shape, header.extents.begin());
+        /* Data reaches the file before the header that declares it complete */
+        if (std::fflush(file.get()) != 0 || std::fseek(file.get(), 0, SEEK_SET) != 0 ||
+            std::fwrite(&header, sizeof(header), 1, file.get()) != 1 || std::fclose(file.release()) != 0) {
+            const int error = errno;
+            file.reset();
+            throw std::system_error(error, std::generic_category(), "TensorWriter: finish " + path);
+        }
+    }
+
+    /* Elements written so far */
+    [[nodiscard]] size_t size() const {
+        return elements;
+    }
+
+private:
+    struct Closer {
+        void operator()(std::FILE* f) const {
+            std::fclose(f);
+        }
+    };
+
+    /* Checks the options before the file is opened, so that bad options leave what is at path untouched */
+    [[nodiscard]] static std::FILE* open(const std::string& path, const TensorFileOptions& options) {
+        if (!std::has_single_bit(options.alignment)) {
+            throw std::invalid_argument("TensorWriter: alignment " + std::to_string(options.alignment) +
+                                        " is not a power of two");
+        }
+        return std::fopen(path.c_str(), "wb");
+    }
+
+    std::unique_ptr<std::FILE, Closer> file;
+    std::string path;
+    std::optional<Shape> expected;
+    detail::Checksum hash;
+    size_t data_offset = 0;
+    size_t elements = 0;
+    bool checksummed;
+};
+
+
+/* A tensor file mapped into memory; view() reads the elements in place, paging them in on first touch.
+ * Throws std::system_error if the file cannot be mapped and std::runtime_error if it is not a complete tensor file of
+ * a version, byte order and element type this build understands. */
+class TensorFile {
+public:
+    explicit TensorFile(const std::string& path) : file(path) {
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error("TensorFile: " + path + " is too short for a header");
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.magic != detail::FileHeader::signature) {
+            throw std::runtime_error("TensorFile: " + path + " is not a tensor file, or was not finished");
+        }
+        if (header.version != detail::FileHeader::current_version) {
+            throw std::runtime_error("TensorFile: " + path + " has unsupported version " +
+                                     std::to_string(header.version));
+        }
+        if (header.byte_order != detail::FileHeader::byte_order_mark) {
+            throw std::runtime_error("TensorFile: " + path + " was written with the other byte order");
+        }
+        const size_t element_size = detail::element_info(header.type).size;
+        if (element_size == 0) {
+            throw std::runtime_error("TensorFile: " + path + " has unknown element type " +
+                                     std::to_string(header.type));
+        }
+        if (header.rank > Shape::max_rank) {
+            throw std::runtime_error("TensorFile: " + path + " has rank " + std::to_string(header.rank));
+        }
+        std::array<size_t, Shape::max_rank> dims{};
+        std::ranges::copy(header.extents, dims.begin());
+        extents = Shape(std::span<const size_t>(dims.data(), header.rank));
+        if (extents.size() != header.count) {
+            throw std::runtime_error("TensorFile: " + path + " declares " + std::to_string(header.count) +
+                                     " elements for shape " + extents.to_string());
+        }
+        if (header.data_offset < sizeof(header) || header.data_offset % element_size != 0 ||
+            header.data_offset > file.size() || (file.size() - header.data_offset) / element_size < header.count) {
+            throw std::runtime_error("TensorFile: " + path + " is truncated or has a bad data offset");
+        }
+    }
+
+    [[nodiscard]] const Shape& shape() const {
+        return extents;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return header.count;
+    }
+
+    [[nodiscard]] ElementType element_type() const {
+        return static_cast<ElementType>(header.type);
+    }
+
+    [[nodiscard]] std::string_view type_name() const {
+        return detail::element_info(header.type).name;
+    }
+
+    /* Byte offset of the first element, e.g. for file_source() */
+    [[nodiscard]] size_t data_offset() const {
+        return header.data_offset;
+    }
+
+    [[nodiscard]] std::optional<uint64_t> checksum() const {
+        if (header.flags & detail::FileHeader::has_checksum) {
+            return header.checksum;
+        }
+        return std::nullopt;
+    }
+
+    /* Reads every element: false if they do not match the stored checksum, true if they do or there is none */
+    [[nodiscard]] bool verify() const {
+        const auto expected = checksum();
+        if (!expected) {
+            return true;
+        }
+        detail::Checksum hash;
+        hash.update(file.data() + header.data_offset, header.count * detail::element_info(header.type).size);
+        return hash.digest() == *expected;
+    }
+
+    /* The elements in place, valid while this object lives; throws std::invalid_argument unless T is the stored type */
+    template <detail::numeric T>
+    [[nodiscard]] TensorView<const T> view() const {
+        if (detail::element_type_of<T>() != element_type()) {
+            throw std::invalid_argument("TensorFile: elements are " + std::string(type_name()) + ", not " +
+                                        std::string(detail::type_name<T>()));
+        }
+        return {file.view<T>(header.data_offset, header.count).data(), extents};
+    }
+
+    void advise_sequential() const {
+        file.advise_sequential();
+    }
+
+private:
+    MappedFile file;
+    detail::FileHeader header;
+    Shape extents;
+};
+
+
+/* Writes expr to a tensor file without materializing it: blocks are evaluated into one of two buffers while the other
+ * is written and checksummed on another thread. Errors throw as for TensorWriter. */
+template <std::derived_from<detail::Expr> E>
+void save(const std::string& path, const E& expr, const TensorFileOptions& options = {}) {
+    using R = typename E::element_type;
+    [[maybe_unused]] const auto probe = detail::profile(EvaluationProfile::Kind::assign, expr, detail::packet_size<R>,
+                                                        detail::parallel_grain<R>, sizeof(R));
+    TensorWriter<R> writer(path, expr.shape(), options);
+    if constexpr (detail::contiguous_leaf<E>) {
+        writer.write(expr.data(), expr.size());
+    } else {
+        const auto& simplified = detail::simplify(expr);
+        const size_t count = expr.size();
+        const size_t block = std::min(count, detail::save_block<R>);
+        std::array<Tensor<R>, 2> buffers{Tensor<R>(Shape{block}), Tensor<R>(Shape{block})};
+        std::future<void> pending;
+        for (size_t first = 0, k = 0; first < count; first += block, k ^= 1) {
+            const size_t length = std::min(block, count - first);
+            R* out = buffers[k].data();
+            if (length < parallel_threshold()) {
+                detail::evaluate_window(out, simplified, first, first + length);
+            } else {
+                detail::thread_pool().parallel_for(length, detail::parallel_grain<R>, [&](size_t lo, size_t hi) {
+                    detail::evaluate_window(out + lo, simplified, first + lo, first + hi);
+                });
+            }
+            if (pending.valid()) {
+                pending.get();
+            }
+            pending = std::async(std::launch::async, [&writer, out, length] { writer.write(out, length); });
+        }
+        if (pending.valid()) {
+            pending.get();
+        }
+    }
+    writer.close();
+}
@@ -0,0 +1,984 @@
+#pragma once
+
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "simd.h"
+#include "type_helper.h"
+
+
+/* Accuracy of exp, log and the trigonometric and hyperbolic functions, selectable per expression (x.exp<tier>())
+ * or for the whole program with TENSOR_FAST_TRANSCENDENTALS */
+enum class Accuracy {
+    precise, /* within 1 ulp: float is evaluated by the double kernels and rounded, double by kernels in
+              * double-double arithmetic, which call the C library only for trigonometric arguments past 2^20 */
+    fast,    /* within 4 ulp: vector kernels in the element type itself */
+};
+
+#if defined(TENSOR_FAST_TRANSCENDENTALS)
+inline constexpr Accuracy default_accuracy = Accuracy::fast;
+#else
+inline constexpr Accuracy default_accuracy = Accuracy::precise;
+#endif
+
+
+namespace detail {
+    /* Cody–Waite splits keep k * hi exact for every reachable k; polynomial coefficients are minimax fits on the
+     * reduced interval, lowest power first */
+    template <floating T>
+    struct KernelConstants;
+
+    template <>
+    struct KernelConstants<float> {
+        static constexpr int mantissa_bits = 23;
+        static constexpr int exponent_bias = 127;
+        static constexpr float min_normal = 0x1p-126f;
+        static constexpr float subnormal_scale = 0x1p25f;
+        static constexpr int subnormal_exponent = 25;
+        /* (x + shifter) - shifter rounds |x| < 2^22 to the nearest integer, which sits in the low mantissa bits */
+        static constexpr float shifter = 0x1.8p23f;
+
+        static constexpr float log2e = 1.44269504f;
+        static constexpr float ln2_hi = 0.693145751953125f;
+        static constexpr float ln2_lo = 1.428606765330187e-06f;
+        static constexpr float ln2 = 0.693147181f;
+        static constexpr float inv_ln10 = 0.434294482f;
+        static constexpr float sqrt2 = 1.41421356f;
+        static constexpr float exp_bound = 170.0f;
+        static constexpr float expm1_floor = -18.0f;
+        static constexpr float hyperbolic_bound = 9.0f;
+        static constexpr float tanh_bound = 10.0f;
+        static constexpr float huge = 0x1p28f;
+
+        static constexpr float two_over_pi = 0.636619772f;
+        static constexpr float tan_pi_8 = 0.414213562f;
+        static constexpr float pi_4_hi = 0.7853981852531433f;
+        static constexpr float pi_4_lo = -2.1855694143368964e-08f;
+        static constexpr float pi_2_hi = 1.5707963705062866f;
+        static constexpr float pi_2_lo = -4.371138828673793e-08f;
+
+        static constexpr float exp_coefficients[] = {
+            0.5f, 0.16666576266288757f, 0.041666556149721146f, 0.008363177999854088f, 0.0013926181709393859f,
+        };
+        static constexpr float log_coefficients[] = {
+            0.6666668653488159f, 0.3998877704143524f, 0.29580044746398926f,
+        };
+        static constexpr float sin_coefficients[] = {
+            -0.1666666716337204f, 0.008333331905305386f, -0.00019840087043121457f, 2.7249925551586784e-06f,
+        };
+        static constexpr float cos_coefficients[] = {
+            0.0416666679084301f, -0.00138888880610466f, 2.480059993104078e-05f, -2.730095900460583e-07f,
+        };
+        static constexpr float atan_coefficients[] = {
+            -0.3333333134651184f, 0.19999539852142334f, -0.14263953268527985f, 0.10743705183267593f,
+            -0.06451841443777084f,
+        };
+    };
+
+    template <>
+    struct KernelConstants<double> {
+        static constexpr int mantissa_bits = 52;
+        static constexpr int exponent_bias = 1023;
+        static constexpr double min_normal = 0x1p-1022;
+        static constexpr double subnormal_scale = 0x1p54;
+        static constexpr int subnormal_exponent = 54;
+        static constexpr double shifter = 0x1.8p52;
+
+        static constexpr double log2e = 1.4426950408889634;
+        static constexpr double ln2_hi = 0.6931471805598903;
+        static constexpr double ln2_lo = 5.497923018708371e-14;
+        static constexpr double ln2 = 0.6931471805599453;
+        static constexpr double inv_ln10 = 0.4342944819032518;
+        static constexpr double sqrt2 = 1.4142135623730951;
+        static constexpr double exp_bound = 1400.0;
+        static constexpr double expm1_floor = -40.0;
+        static constexpr double hyperbolic_bound = 22.0;
+        static constexpr double tanh_bound = 22.0;
+        static constexpr double huge = 0x1p28;
+
+        static constexpr double tan_pi_8 = 0.41421356237309503;
+        static constexpr double pi_4_hi = 0.7853981633974483;
+        static constexpr double pi_4_lo = 3.061616997868383e-17;
+        static constexpr double pi_2_hi = 1.5707963267948966;
+        static constexpr double pi_2_lo = 6.123233995736766e-17;
+
+        /* pi/2 in three pieces, the first two with 33 significant bits: k * piece is exact for k < 2^20 */
+        static constexpr double two_over_pi = 0.6366197723675814;
+        static constexpr double pio2_1 = 1.5707963267341256;
+        static constexpr double pio2_2 = 6.077100506303966e-11;
+        static constexpr double pio2_3 = 2.0222662487959506e-21;
+        static constexpr double trig_bound = 0x1p20;
+
+        static constexpr double exp_coefficients[] = {
+            0.5000000000000001, 0.16666666666666669, 0.041666666666624136, 0.008333333333330063,
+            0.001388888891720967, 0.00019841269863050506, 2.4801521302241082e-05, 2.7557268464831627e-06,
+            2.7620085455018414e-07, 2.510038319586702e-08,
+        };
+        static constexpr double log_coefficients[] = {
+            0.666666666666667, 0.3999999999989945, 0.28571428626001427, 0.22222211130560726, 0.18182889433757515,
+            0.15331711346672997, 0.14616576421644387,
+        };
+        static constexpr double sin_coefficients[] = {
+            -0.16666666666666666, 0.008333333333330948, -0.00019841269836758582, 2.7557316102556606e-06,
+            -2.50511318458721e-08, 1.5918129357436853e-10,
+        };
+        static constexpr double cos_coefficients[] = {
+            0.041666666666666664, -0.0013888888888887398, 2.4801587298765693e-05, -2.75573172717324e-07,
+            2.0876146268946504e-09, -1.1382632464665116e-11,
+        };
+        static constexpr double atan_coefficients[] = {
+            -0.3333333333333333, 0.19999999999995519, -0.14285714284666184, 0.11111111015227572,
+            -0.09090904576954117, 0.07692183163650894, -0.06664511064599371, 0.05858145587628202,
+            -0.050854323376990765, 0.0392311556198723, -0.01917627151752634,
+        };
+    };
+
+    /* Constants of the precise double kernels; those that follow an fdlibm kernel take fdlibm's, on which its error
+     * bounds rest */
+    struct PreciseConstants {
+        /* pi/2 = pio2_1 + pio2_2 + pio2_3 + pio2_3t within 2^-159, the first three with 33 significant bits */
+        static constexpr double pio2_1 = 1.57079632673412561417e+00;
+        static constexpr double pio2_2 = 6.07710050630396597660e-11;
+        static constexpr double pio2_3 = 2.02226624871116645580e-21;
+        static constexpr double pio2_3t = 8.47842766036889956997e-32;
+
+        static constexpr double pi = 3.14159265358979311600e+00;
+        static constexpr double pio2_hi = 1.57079632679489655800e+00;
+        static constexpr double pio2_lo = 6.12323399573676603587e-17;
+        static constexpr double pio4_hi = 7.85398163397448278999e-01;
+        static constexpr double ln2_lo = 2.3190468138462996e-17; /* ln2 - KernelConstants<double>::ln2 */
+        static constexpr double inv_ln10_lo = 1.098319650216765e-17;
+
+        /* 1/3!, ..., 1/15!: e^r - 1 - r - r^2/2 = r^3 E(r) within 2^-68 of e^r - 1 for |r| <= ln2 / 2 */
+        static constexpr double exp_coefficients[] = {
+            0.16666666666666666, 0.041666666666666664, 0.008333333333333333, 0.001388888888888889,
+            0.0001984126984126984, 2.48015873015873e-05, 2.7557319223985893e-06, 2.755731922398589e-07,
+            2.505210838544172e-08, 2.08767569878681e-09, 1.6059043836821613e-10, 1.1470745597729725e-11,
+            7.647163731819816e-13,
+        };
+        /* Lg1, ..., Lg7 */
+        static constexpr double log_coefficients[] = {
+            6.666666666666735130e-01, 3.999999999940941908e-01, 2.857142874366239149e-01, 2.222219843214978396e-01,
+            1.818357216161805012e-01, 1.531383769920937332e-01, 1.479819860511658591e-01,
+        };
+        /* S1, and S2, ..., S6 */
+        static constexpr double sin_s1 = -1.66666666666666324348e-01;
+        static constexpr double sin_coefficients[] = {
+            8.33333333332248946124e-03, -1.98412698298579493134e-04, 2.75573137070700676789e-06,
+            -2.50507602534068634195e-08, 1.58969099521155010221e-10,
+        };
+        /* C1, ..., C6 */
+        static constexpr double cos_coefficients[] = {
+            4.16666666666666019037e-02, -1.38888888888741095749e-03, 2.48015872894767294178e-05,
+            -2.75573143513906633035e-07, 2.08757232129817482790e-09, -1.13596475577881948265e-11,
+        };
+        /* aT[0], ..., aT[10], and atan(1/2), atan(1), atan(3/2), atan(inf) in two pieces */
+        static constexpr double atan_coefficients[] = {
+            3.33333333333329318027e-01, -1.99999999998764832476e-01, 1.42857142725034663711e-01,
+            -1.11111104054623557880e-01, 9.09088713343650656196e-02, -7.69187620504482999495e-02,
+            6.66107313738753120669e-02, -5.83357013379057348645e-02, 4.97687799461593236017e-02,
+            -3.65315727442169155270e-02, 1.62858201153657823623e-02,
+        };
+        static constexpr double atan_hi[] = {
+            4.63647609000806093515e-01, 7.85398163397448278999e-01, 9.82793723247329054082e-01,
+            1.57079632679489655800e+00,
+        };
+        static constexpr double atan_lo[] = {
+            2.26987774529616870924e-17, 3.06161699786838301793e-17, 1.39033110312309984516e-17,
+            6.12323399573676603587e-17,
+        };
+        /* pS0, ..., pS5 and 1, qS1, ..., qS4 */
+        static constexpr double asin_p[] = {
+            1.66666666666666657415e-01, -3.25565818622400915405e-01, 2.01212532134862925881e-01,
+            -4.00555345006794114027e-02, 7.91534994289814532176e-04, 3.47933107596021167570e-05,
+        };
+        static constexpr double asin_q[] = {
+            1.0, -2.40339491173441421878e+00, 2.02094576023350569471e+00, -6.88283971605453293030e-01,
+            7.70381505559019352791e-02,
+        };
+    };
+
+
+    template <typename V>
+    [[nodiscard]] constexpr V splat(vector_lane<V> value) {
+        return value - V{};
+    }
+
+    template <typename M, typename V>
+    [[nodiscard]] constexpr V blend(const M& mask, const V& x, const V& y) {
+        return (V) ((mask & (M) x) | (~mask & (M) y));
+    }
+
+    template <typename V>
+    [[nodiscard]] constexpr V abs_lanes(const V& x) {
+        using M = vector_mask<V>;
+        return (V) ((M) x & ~(M) splat<V>(-0.0));
+    }
+
+    /* Magnitude of x with the sign of s */
+    template <typename V>
+    [[nodiscard]] constexpr V copysign_lanes(const V& x, const V& s) {
+        using M = vector_mask<V>;
+        const M sign = (M) splat<V>(-0.0);
+        return (V) (((M) x & ~sign) | ((M) s & sign));
+    }
+
+    template <typename V>
+    [[nodiscard]] V madd(const V& x, const V& y, const V& z) {
+        if constexpr (hardware_fma) {
+            return fused_multiply_add(x, y, z);
+        } else {
+            return x * y + z;
+        }
+    }
+
+    template <typename V>
+    [[nodiscard]] V sqrt_lanes(const V& x) {
+        V result;
+        for (size_t i = 0; i < sizeof(V) / sizeof(vector_lane<V>); ++i) {
+            result[i] = std::sqrt(x[i]);
+        }
+        return result;
+    }
+
+    template <typename V, size_t K>
+    [[nodiscard]] V horner(const V& x, const vector_lane<V> (&coefficients)[K]) {
+        V result = splat<V>(coefficients[K - 1]);
+        for (size_t i = K - 1; i-- > 0;) {
+            result = madd(result, x, splat<V>(coefficients[i]));
+        }
+        return result;
+    }
+
+    /* Count lanes of x starting at First, and two vectors joined end to end */
+    template <size_t First, size_t Count, typename V>
+    [[nodiscard]] auto lanes(const V& x) {
+        return [&]<size_t... I>(std::index_sequence<I...>) {
+            return __builtin_shufflevector(x, x, (First + I)...);
+        }(std::make_index_sequence<Count>{});
+    }
+
+    template <typename V>
+    [[nodiscard]] auto concat(const V& lo, const V& hi) {
+        return [&]<size_t... I>(std::index_sequence<I...>) {
+            return __builtin_shufflevector(lo, hi, I...);
+        }(std::make_index_sequence<2 * sizeof(V) / sizeof(vector_lane<V>)>{});
+    }
+
+    /* f applied to float lanes widened to double, split into halves until each fits a register, so that no
+     * function passes a vector the target cannot hold */
+    template <typename F, typename V, typename... Vs>
+    [[nodiscard]] V in_double(F f, const V& x, const Vs&... xs) {
+        constexpr size_t N = sizeof(V) / sizeof(float);
+        if constexpr (N <= packet_size<double>) {
+            using W = typename Packet<double, N>::vector_type;
+            return __builtin_convertvector(f(__builtin_convertvector(x, W), __builtin_convertvector(xs, W)...), V);
+        } else {
+            return concat(in_double(f, lanes<0, N / 2>(x), lanes<0, N / 2>(xs)...),
+                          in_double(f, lanes<N / 2, N / 2>(x), lanes<N / 2, N / 2>(xs)...));
+        }
+    }
+
+    /* 2^k for integer lanes k within the normal exponent range */
+    template <typename V, typename M>
+    [[nodiscard]] V pow2(const M& k) {
+        using C = KernelConstants<vector_lane<V>>;
+        return (V) ((k + C::exponent_bias) << C::mantissa_bits);
+    }
+
+    /* Integer lanes |k| < 2^22 back to floating point, through the shifter rather than a conversion instruction */
+    template <typename V, typename M>
+    [[nodiscard]] V to_lanes(const M& k) {
+        using C = KernelConstants<vector_lane<V>>;
+        return (V) (k + (M) splat<V>(C::shifter)) - C::shifter;
+    }
+
+    /* x = k ln2 + r with |r| <= ln2 / 2 */
+    template <typename V>
+    [[nodiscard]] V reduce_ln2(const V& x, vector_mask<V>& k) {
+        using C = KernelConstants<vector_lane<V>>;
+        using M = vector_mask<V>;
+        const V shifted = madd(x, splat<V>(C::log2e), splat<V>(C::shifter));
+        k = (M) shifted - (M) splat<V>(C::shifter);
+        const V kf = shifted - C::shifter;
+        const V r = madd(kf, splat<V>(-C::ln2_hi), x);
+        return madd(kf, splat<V>(-C::ln2_lo), r);
+    }
+
+    /* e^r - 1 on the reduced interval; written as r + r (r g(r)) so that -0.0 survives */
+    template <typename V>
+    [[nodiscard]] V expm1_reduced(const V& r) {
+        using C = KernelConstants<vector_lane<V>>;
+        return madd(r, r * horner(r, C::exp_coefficients), r);
+    }
+
+
+    /* e^x; the scale 2^k is applied in two halves so results near overflow and in the subnormal range round once */
+    template <typename V>
+    [[nodiscard]] V exp_kernel(const V& x) {
+        using C = KernelConstants<vector_lane<V>>;
+        using M = vector_mask<V>;
+        const V clamped = blend(x > C::exp_bound, splat<V>(C::exp_bound),
+                                blend(x < -C::exp_bound, splat<V>(-C::exp_bound), x));
+        M k;
+        const V p = 1 + expm1_reduced(reduce_ln2(clamped, k));
+        const M half = k >> 1;
+        return blend(x != x, x, p * pow2<V>(half) * pow2<V>(k - half));
+    }
+
+    template <typename V>
+    [[nodiscard]] V expm1_kernel(const V& x) {
+        using C = KernelConstants<vector_lane<V>>;
+        using M = vector_mask<V>;
+        const V clamped = blend(x > C::exp_bound, splat<V>(C::exp_bound),
+                                blend(x < C::expm1_floor, splat<V>(C::expm1_floor), x));
+        M k;
+        const V em = expm1_reduced(reduce_ln2(clamped, k));
+        /* k > 0: 2^k (em + (1 - 2^-k)), where 1 - 2^-k is exact or rounds to 1; k < 0: 2^k em + (2^k - 1) */
+        const M capped = blend(k > C::mantissa_bits + 2, M{} + (C::mantissa_bits + 2), k);
+        const M half = k >> 1;
+        const V above = (em + (1 - pow2<V>(-capped))) * pow2<V>(half) * pow2<V>(k - half);
+        const V scale = pow2<V>(blend(k < 0, k, M{}));
+        const V below = madd(em, scale, scale - 1);
+        const V result = blend(k == 0, em, blend(k > 0, above, below));
+        return blend(x != x, x, result);
+    }
+
+    /* x = 2^e m with sqrt(2)/2 <= m < sqrt(2), for positive finite x; returns m */
+    template <typename V>
+    [[nodiscard]] V reduce_exponent(const V& x, vector_mask<V>& e) {
+        using T = vector_lane<V>;
+        using C = KernelConstants<T>;
+        using M = vector_mask<V>;
+        const M tiny = x < C::min_normal;
+        const M bits = (M) blend(tiny, x * C::subnormal_scale, x);
+        const M exponent_mask = ((M{} + 1) << (sizeof(T) * 8 - 1 - C::mantissa_bits)) - 1;
+        const M mantissa_mask = ((M{} + 1) << C::mantissa_bits) - 1;
+        e = ((bits >> C::mantissa_bits) & exponent_mask) - C::exponent_bias - (tiny & C::subnormal_exponent);
+        const V m = (V) ((bits & mantissa_mask) | (M) splat<V>(1));
+        const M high = m > C::sqrt2;
+        e -= high;
+        return blend(high, m * T(0.5), m);
+    }
+
+    /* result where log(x) is finite; -inf, inf or NaN elsewhere */
+    template <typename V>
+    [[nodiscard]] V log_domain(const V& x, const V& result) {
+        const V inf = splat<V>(INFINITY);
+        return blend(x == 0, -inf, blend(x == inf, inf, blend((x < 0) | (x != x), splat<V>(NAN), result)));
+    }
+
+    /* fdlibm's log: x = 2^k (1 + f) with sqrt(2)/2 <= 1 + f < sqrt(2), s = f / (2 + f),
+     * log(1 + f) = f - f^2/2 + s (f^2/2 + R(s^2)) */
+    template <typename V>
+    [[nodiscard]] V log_kernel(const V& x) {
+        using T = vector_lane<V>;
+        using C = KernelConstants<T>;
+        using M = vector_mask<V>;
+        M e;
+        const V f = reduce_exponent(x, e) - 1;
+        const V s = f / (2 + f);
+        const V z = s * s;
+        const V r = z * horner(z, C::log_coefficients);
+        const V hfsq = T(0.5) * f * f;
+        const V k = to_lanes<V>(e);
+        return log_domain(x, k * C::ln2_hi - ((hfsq - madd(s, hfsq + r, k * C::ln2_lo)) - f));
+    }
+
+    /* log(1 + x) = log(u) + (x - (u - 1)) / u with u = 1 + x rounded, the second term restoring what the rounding
+     * lost */
+    template <typename V>
+    [[nodiscard]] V log1p_kernel(const V& x) {
+        const V u = 1 + x;
+        const V correction = blend((u == 0) | (u == INFINITY), V{}, (x - (u - 1)) / u);
+        return blend(x == 0, x, log_kernel(u) + correction);
+    }
+
+    /* x - k pi/2 in double */
+    template <typename V>
+    [[nodiscard]] V cody_waite_pio2(const V& x, const V& k) {
+        using D = KernelConstants<double>;
+        V r = madd(k, splat<V>(-D::pio2_1), x);
+        r = madd(k, splat<V>(-D::pio2_2), r);
+        return madd(k, splat<V>(-D::pio2_3), r);
+    }
+
+    /* x = k pi/2 + r; returns r and sets quadrant to k. Float picks k in float and subtracts in double. */
+    template <typename V>
+    [[nodiscard]] V reduce_pio2(const V& x, vector_mask<V>& quadrant) {
+        using C = KernelConstants<vector_lane<V>>;
+        using M = vector_mask<V>;
+        const V shifted = madd(x, splat<V>(C::two_over_pi), splat<V>(C::shifter));
+        const V k = shifted - C::shifter;
+        quadrant = (M) shifted - (M) splat<V>(C::shifter);
+        if constexpr (std::is_same_v<vector_lane<V>, double>) {
+            return cody_waite_pio2(x, k);
+        } else {
+            return in_double([](const auto& xd, const auto& kd) { return cody_waite_pio2(xd, kd); }, x, k);
+        }
+    }
+
+    /* sin and cos together, the quadrant choosing and negating the polynomials. Lanes past trig_bound, where
+     * k * pio2_1 stops being exact, go to the C library. */
+    template <typename V>
+    void sincos_kernel(const V& x, V& sin_x, V& cos_x) {
+        using T = vector_lane<V>;
+        using C = KernelConstants<T>;
+        using M = vector_mask<V>;
+        constexpr size_t N = sizeof(V) / sizeof(T);
+
+        M quadrant;
+        const V r = reduce_pio2(x, quadrant);
+        const V z = r * r;
+        const V sin_r = madd(r * z, horner(z, C::sin_coefficients), r);
+        const V hz = T(0.5) * z;
+        const V w = 1 - hz;
+        const V cos_r = w + (((1 - w) - hz) + z * z * horner(z, C::cos_coefficients));
+
+        const M sign = (M) splat<V>(-0.0);
+        const M odd = (quadrant & 1) != 0;
+        sin_x = (V) ((M) blend(odd, cos_r, sin_r) ^ (((quadrant & 2) != 0) & sign));
+        cos_x = (V) ((M) blend(odd, sin_r, cos_r) ^ ((((quadrant + 1) & 2) != 0) & sign));
+        /* r + r^3 S(r^2) rounds -0.0 to +0.0 */
+        sin_x = blend(x == 0, x, sin_x);
+
+        const M far = abs_lanes(x) > KernelConstants<double>::trig_bound;
+        for (size_t i = 0; i < N; ++i) {
+            if (far[i]) {
+                sin_x[i] = std::sin(x[i]);
+                cos_x[i] = std::cos(x[i]);
+            }
+        }
+    }
+
+    template <typename V>
+    [[nodiscard]] V sin_kernel(const V& x) {
+        V sin_x, cos_x;
+        sincos_kernel(x, sin_x, cos_x);
+        return sin_x;
+    }
+
+    template <typename V>
+    [[nodiscard]] V cos_kernel(const V& x) {
+        V sin_x, cos_x;
+        sincos_kernel(x, sin_x, cos_x);
+        return cos_x;
+    }
+
+    template <typename V>
+    [[nodiscard]] V tan_kernel(const V& x) {
+        V sin_x, cos_x;
+        sincos_kernel(x, sin_x, cos_x);
+        return sin_x / cos_x;
+    }
+
+    /* |x| > 1 reflects through atan(x) = pi/2 - atan(1/x), then |x| > tan(pi/8) shifts by atan(1) = pi/4,
+     * leaving |u| <= tan(pi/8) for atan(u) = u + u^3 A(u^2) */
+    template <typename V>
+    [[nodiscard]] V atan_kernel(const V& x) {
+        using T = vector_lane<V>;
+        using C = KernelConstants<T>;
+        const V a = abs_lanes(x);
+        const auto inverted = a > 1;
+        const V t = blend(inverted, 1 / a, a);
+        const auto shifted = t > C::tan_pi_8;
+        const V u = blend(shifted, (t - 1) / (t + 1), t);
+        const V z = u * u;
+        V result = madd(u * z, horner(z, C::atan_coefficients), u);
+        result = blend(shifted, C::pi_4_hi + (result + C::pi_4_lo), result);
+        result = blend(inverted, (C::pi_2_hi - result) + C::pi_2_lo, result);
+        return copysign_lanes(result, x);
+    }
+
+    template <typename V>
+    [[nodiscard]] V asin_kernel(const V& x) {
+        const V a = abs_lanes(x);
+        return copysign_lanes(atan_kernel(a / sqrt_lanes((1 - a) * (1 + a))), x);
+    }
+
+    template <typename V>
+    [[nodiscard]] V acos_kernel(const V& x) {
+        return 2 * atan_kernel(sqrt_lanes((1 - x) / (1 + x)));
+    }
+
+    /* Hyperbolic functions follow fdlibm: expm1 near zero, where e^x - e^-x cancels; e^|x| / 2 once the other
+     * exponential no longer matters, computed as (e^(|x|/2) / 2) e^(|x|/2) so it overflows only when the result does */
+    template <typename V>
+    [[nodiscard]] V sinh_kernel(const V& x) {
+        using T = vector_lane<V>;
+        using C = KernelConstants<T>;
+        const V a = abs_lanes(x);
+        const V t = expm1_kernel(a);
+        const V near = T(0.5) * blend(a < 1, 2 * t - t * t / (t + 1), t + t / (t + 1));
+        const V w = exp_kernel(T(0.5) * a);
+        const V result = blend(a < C::hyperbolic_bound, near, T(0.5) * w * w);
+        return copysign_lanes(result, x);
+    }
+
+    template <typename V>
+    [[nodiscard]] V cosh_kernel(const V& x) {
+        using T = vector_lane<V>;
+        using C = KernelConstants<T>;
+        const V a = abs_lanes(x);
+        const V t = expm1_kernel(a);
+        const V small = 1 + t * t / (2 * (1 + t));
+        const V e = exp_kernel(a);
+        const V medium = T(0.5) * e + T(0.5) / e;
+        const V w = exp_kernel(T(0.5) * a);
+        return blend(a < T(0.5) * C::ln2, small, blend(a < C::hyperbolic_bound, medium, T(0.5) * w * w));
+    }
+
+    template <typename V>
+    [[nodiscard]] V tanh_kernel(const V& x) {
+        using C = KernelConstants<vector_lane<V>>;
+        const V a = abs_lanes(x);
+        const V t = expm1_kernel(-2 * a);
+        const V small = -t / (t + 2);
+        const V u = expm1_kernel(2 * a);
+        const V medium = 1 - 2 / (u + 2);
+        const V result = blend(a < 1, small, blend(a < C::tanh_bound, medium, splat<V>(1)));
+        return blend(x != x, x, copysign_lanes(result, x));
+    }
+
+    template <typename V>
+    [[nodiscard]] V asinh_kernel(const V& x) {
+        using C = KernelConstants<vector_lane<V>>;
+        const V a = abs_lanes(x);
+        const V a2 = a * a;
+        const V small = log1p_kernel(a + a2 / (1 + sqrt_lanes(1 + a2)));
+        const V medium = log_kernel(2 * a + 1 / (sqrt_lanes(a2 + 1) + a));
+        const V large = log_kernel(a) + C::ln2;
+        return copysign_lanes(blend(a > 2, blend(a > C::huge, large, medium), small), x);
+    }
+
+    template <typename V>
+    [[nodiscard]] V acosh_kernel(const V& x) {
+        using C = KernelConstants<vector_lane<V>>;
+        const V t = x - 1;
+        const V small = log1p_kernel(t + sqrt_lanes(2 * t + t * t));
+        const V medium = log_kernel(2 * x - 1 / (x + sqrt_lanes(x * x - 1)));
+        const V large = log_kernel(x) + C::ln2;
+        const V result = blend(x > 2, blend(x > C::huge, large, medium), small);
+        return blend(x < 1, splat<V>(NAN), result);
+    }
+
+    template <typename V>
+    [[nodiscard]] V atanh_kernel(const V& x) {
+        using T = vector_lane<V>;
+        const V a = abs_lanes(x);
+        const V twice = 2 * a;
+        const V small = log1p_kernel(twice + twice * a / (1 - a));
+        const V large = log1p_kernel(twice / (1 - a));
+        return copysign_lanes(T(0.5) * blend(a < T(0.5), small, large), x);
+    }
+
+    template <typename V>
+    [[nodiscard]] V log10_kernel(const V& x) {
+        return log_kernel(x) * KernelConstants<vector_lane<V>>::inv_ln10;
+    }
+
+
+    /* The precise double kernels. Each carries what would otherwise cost more than half an ulp as an unevaluated sum
+     * of two doubles, about 106 bits (double-double arithmetic), and rounds once at the end. */
+    template <typename V>
+    struct Pair {
+        V hi;
+        V lo;
+    };
+
+    /* a + b exactly (Knuth) */
+    template <typename V>
+    [[nodiscard]] Pair<V> two_sum(const V& a, const V& b) {
+        const V s = a + b;
+        const V t = s - a;
+        return {s, (a - (s - t)) + (b - t)};
+    }
+
+    /* a + b exactly when |a| >= |b| (Dekker) */
+    template <typename V>
+    [[nodiscard]] Pair<V> fast_two_sum(const V& a, const V& b) {
+        const V s = a + b;
+        return {s, b - (s - a)};
+    }
+
+    /* a * b exactly, barring underflow: the rounding error of the product is the fused x * y - p, or without hardware
+     * FMA comes from Dekker's product of the halves split at 2^27 + 1 */
+    template <typename V>
+    [[nodiscard]] Pair<V> two_product(const V& a, const V& b) {
+        const V p = a * b;
+        if constexpr (hardware_fma) {
+            return {p, fused_multiply_add(a, b, -p)};
+        } else {
+            const auto split = [](const V& x) {
+                const V c = 134217729.0 * x;
+                const V hi = c - (c - x);
+                return Pair<V>{hi, x - hi};
+            };
+            const Pair<V> x = split(a);
+            const Pair<V> y = split(b);
+            return {p, ((x.hi * y.hi - p) + x.hi * y.lo + x.lo * y.hi) + x.lo * y.lo};
+        }
+    }
+
+    template <typename V>
+    [[nodiscard]] Pair<V> operator+(const Pair<V>& a, const Pair<V>& b) {
+        const Pair<V> s = two_sum(a.hi, b.hi);
+        const Pair<V> t = two_sum(a.lo, b.lo);
+        const Pair<V> u = fast_two_sum(s.hi, s.lo + t.hi);
+        return fast_two_sum(u.hi, u.lo + t.lo);
+    }
+
+    template <typename V>
+    [[nodiscard]] Pair<V> operator+(const Pair<V>& a, const V& b) {
+        const Pair<V> s = two_sum(a.hi, b);
+        return fast_two_sum(s.hi, s.lo + a.lo);
+    }
+
+    template <typename V>
+    [[nodiscard]] Pair<V> operator*(const Pair<V>& a, const Pair<V>& b) {
+        const Pair<V> p = two_product(a.hi, b.hi);
+        return fast_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+    }
+
+    /* The quotient of the high parts, corrected by the remainder once */
+    template <typename V>
+    [[nodiscard]] Pair<V> operator/(const Pair<V>& a, const Pair<V>& b) {
+        const V q = a.hi / b.hi;
+        const Pair<V> p = two_product(q, b.hi);
+        return fast_two_sum(q, ((((a.hi - p.hi) - p.lo) + a.lo) - q * b.lo) / b.hi);
+    }
+
+    /* The root of the high part, corrected by one Newton step; a >= 0 */
+    template <typename V>
+    [[nodiscard]] Pair<V> sqrt_pair(const Pair<V>& a) {
+        const V s = sqrt_lanes(a.hi);
+        const Pair<V> p = two_product(s, s);
+        const V correction = (((a.hi - p.hi) - p.lo) + a.lo) / (s + s);
+        return fast_two_sum(s, blend(s == 0, V{}, correction));
+    }
+
+    /* e^r - 1 as a pair, x = k ln2 + r, setting k. The reduction is exact with r a pair; r + r^2/2 is summed exactly
+     * and only the rest, below r^3/6, rounded. */
+    template <typename V>
+    [[nodiscard]] Pair<V> expm1_reduced_pair(const V& x, vector_mask<V>& k) {
+        using C = KernelConstants<double>;
+        using P = PreciseConstants;
+        using M = vector_mask<V>;
+        const V shifted = madd(x, splat<V>(C::log2e), splat<V>(C::shifter));
+        k = (M) shifted - (M) splat<V>(C::shifter);
+        const V kf = shifted - C::shifter;
+        const Pair<V> tail = two_product(kf, splat<V>(C::ln2_lo));
+        const Pair<V> r = two_sum(x - kf * C::ln2_hi, -tail.hi);
+        const Pair<V> square = two_product(r.hi, r.hi);
+        const Pair<V> head = fast_two_sum(r.hi, 0.5 * square.hi);
+        const V rest = r.hi * square.hi * horner(r.hi, P::exp_coefficients);
+        /* r.lo moves e^r - 1 by r.lo e^r */
+        const V lo = 0.5 * square.lo + (rest + (r.lo - tail.lo) * (1 + head.hi));
+        return fast_two_sum(head.hi, head.lo + lo);
+    }
+
+    /* e^x / 2^s for |x| <= exp_bound, scaled in two halves as in exp_kernel */
+    template <typename V>
+    [[nodiscard]] V exp_scaled(const V& x, int s) {
+        using M = vector_mask<V>;
+        M k;
+        const Pair<V> em = expm1_reduced_pair(x, k);
+        const Pair<V> p = fast_two_sum(splat<V>(1), em.hi);
+        k -= s;
+        const M half = k >> 1;
+        return (p.hi + (p.lo + em.lo)) * pow2<V>(half) * pow2<V>(k - half);
+    }
+
+    /* e^a - 1 as a pair for 0 <= a <= 2 tanh_bound: 2^k em + (2^k - 1), neither part rounded */
+    template <typename V>
+    [[nodiscard]] Pair<V> expm1_pair(const V& a) {
+        vector_mask<V> k;
+        const Pair<V> em = expm1_reduced_pair(a, k);
+        const V scale = pow2<V>(k);
+        return Pair<V>{em.hi * scale, em.lo * scale} + two_sum(scale, splat<V>(-1));
+    }
+
+    template <typename V>
+    [[nodiscard]] V exp_precise(const V& x) {
+        using C = KernelConstants<double>;
+        const V clamped = blend(x > C::exp_bound, splat<V>(C::exp_bound),
+                                blend(x < -C::exp_bound, splat<V>(-C::exp_bound), x));
+        return blend(x != x, x, exp_scaled(clamped, 0));
+    }
+
+    /* sinh = (t + t / (t + 1)) / 2 and cosh = (e + 1/e) / 2, with t = e^|x| - 1 and e = e^|x|, add terms of one
+     * sign; past hyperbolic_bound both are e^|x| / 2 */
+    template <typename V>
+    [[nodiscard]] V sinh_precise(const V& x) {
+        using C = KernelConstants<double>;
+        const V a = abs_lanes(x);
+        const auto near = a < C::hyperbolic_bound;
+        const Pair<V> t = expm1_pair(blend(near, a, V{}));
+        const Pair<V> s = t + t / (t + splat<V>(1));
+        const V far = exp_scaled(blend(a > C::exp_bound, splat<V>(C::exp_bound), a), 1);
+        return blend(x != x, x, copysign_lanes(blend(near, 0.5 * (s.hi + s.lo), far), x));
+    }
+
+    template <typename V>
+    [[nodiscard]] V cosh_precise(const V& x) {
+        using C = KernelConstants<double>;
+        const V a = abs_lanes(x);
+        const auto near = a < C::hyperbolic_bound;
+        const Pair<V> e = expm1_pair(blend(near, a, V{})) + splat<V>(1);
+        const Pair<V> c = e + Pair<V>{splat<V>(1), V{}} / e;
+        const V far = exp_scaled(blend(a > C::exp_bound, splat<V>(C::exp_bound), a), 1);
+        return blend(x != x, x, blend(near, 0.5 * (c.hi + c.lo), far));
+    }
+
+    /* tanh = t / (t + 2) with t = e^2|x| - 1; 1 past tanh_bound */
+    template <typename V>
+    [[nodiscard]] V tanh_precise(const V& x) {
+        using C = KernelConstants<double>;
+        const V a = abs_lanes(x);
+        const auto near = a < C::tanh_bound;
+        const Pair<V> t = expm1_pair(2 * blend(near, a, V{}));
+        const Pair<V> q = t / (t + splat<V>(2));
+        return blend(x != x, x, copysign_lanes(blend(near, q.hi + q.lo, splat<V>(1)), x));
+    }
+
+    /* log(x) as a pair for positive finite x, on log_kernel's decomposition: f - f^2/2 is summed exactly and only
+     * s (f^2/2 + R(s^2)), below f^3/3, rounded */
+    template <typename V>
+    [[nodiscard]] Pair<V> log_pair(const V& x) {
+        using C = KernelConstants<double>;
+        using P = PreciseConstants;
+        vector_mask<V> e;
+        const V f = reduce_exponent(x, e) - 1;
+        const V s = f / (2 + f);
+        const V z = s * s;
+        const V r = z * horner(z, P::log_coefficients);
+        const Pair<V> square = two_product(f, f);
+        const V hfsq = 0.5 * square.hi;
+        const Pair<V> head = fast_two_sum(f, -hfsq);
+        const Pair<V> log_m = fast_two_sum(head.hi, head.lo + madd(s, hfsq + r, -0.5 * square.lo));
+        const V k = to_lanes<V>(e);
+        const Pair<V> sum = two_sum(k * C::ln2_hi, log_m.hi);
+        return fast_two_sum(sum.hi, sum.lo + (log_m.lo + k * C::ln2_lo));
+    }
+
+    /* log(1 + t) for a pair t >= 0: log(u) + log(1 + d) with u = 1 + t and d = u.lo / u.hi, the second term
+     * d - d^2/2 to within 2^-159 */
+    template <typename V>
+    [[nodiscard]] Pair<V> log1p_pair(const Pair<V>& t) {
+        const Pair<V> u = t + splat<V>(1);
+        const Pair<V> d = Pair<V>{u.lo, V{}} / Pair<V>{u.hi, V{}};
+        return log_pair(u.hi) + (d + -0.5 * d.hi * d.hi);
+    }
+
+    template <typename V>
+    [[nodiscard]] V log_precise(const V& x) {
+        const Pair<V> l = log_pair(x);
+        return log_domain(x, l.hi + l.lo);
+    }
+
+    template <typename V>
+    [[nodiscard]] V log10_precise(const V& x) {
+        using C = KernelConstants<double>;
+        const Pair<V> l = log_pair(x) * Pair<V>{splat<V>(C::inv_ln10), splat<V>(PreciseConstants::inv_ln10_lo)};
+        return log_domain(x, l.hi + l.lo);
+    }
+
+    /* asinh = log1p(|x| + x^2 / (1 + sqrt(1 + x^2))), and log|x| + ln2 past huge, where 1/x^2 no longer counts */
+    template <typename V>
+    [[nodiscard]] V asinh_precise(const V& x) {
+        using C = KernelConstants<double>;
+        const V a = abs_lanes(x);
+        const auto near = a <= C::huge;
+        const V b = blend(near, a, V{});
+        const Pair<V> square = two_product(b, b);
+        const Pair<V> small = log1p_pair(square / (sqrt_pair(square + splat<V>(1)) + splat<V>(1)) + b);
+        const Pair<V> large = log_pair(a) + Pair<V>{splat<V>(C::ln2), splat<V>(PreciseConstants::ln2_lo)};
+        const V result = blend(near, small.hi + small.lo, large.hi + large.lo);
+        return blend((x != x) | (a == INFINITY), x, copysign_lanes(result, x));
+    }
+
+    /* acosh = log1p((x - 1) + sqrt(x^2 - 1)), x - 1 exact and x^2 - 1 a pair; log(x) + ln2 past huge */
+    template <typename V>
+    [[nodiscard]] V acosh_precise(const V& x) {
+        using C = KernelConstants<double>;
+        const auto near = x <= C::huge;
+        const V b = blend(near, x, splat<V>(1));
+        const Pair<V> small = log1p_pair(sqrt_pair(two_product(b, b) + splat<V>(-1)) + (b - 1));
+        const Pair<V> large = log_pair(x) + Pair<V>{splat<V>(C::ln2), splat<V>(PreciseConstants::ln2_lo)};
+        const V result = blend(near, small.hi + small.lo, large.hi + large.lo);
+        return blend(x == INFINITY, x, blend((x < 1) | (x != x), splat<V>(NAN), result));
+    }
+
+    /* atanh = log1p(2|x| / (1 - |x|)) / 2, 1 - |x| exact as a pair */
+    template <typename V>
+    [[nodiscard]] V atanh_precise(const V& x) {
+        const V a = abs_lanes(x);
+        const Pair<V> l = log1p_pair(Pair<V>{2 * a, V{}} / two_sum(splat<V>(1), -a));
+        const V result = blend(a == 1, splat<V>(INFINITY), blend(a > 1, splat<V>(NAN), 0.5 * (l.hi + l.lo)));
+        return blend(x != x, x, copysign_lanes(result, x));
+    }
+
+    /* x - k pi/2 as a pair, setting quadrant to k, for |x| <= trig_bound: k times each piece of pi/2 is exact but
+     * for the last, and they are subtracted as pairs, so that no cancellation goes unseen */
+    template <typename V>
+    [[nodiscard]] Pair<V> reduce_pio2_pair(const V& x, vector_mask<V>& quadrant) {
+        using C = KernelConstants<double>;
+        using P = PreciseConstants;
+        using M = vector_mask<V>;
+        const V shifted = madd(x, splat<V>(C::two_over_pi), splat<V>(C::shifter));
+        const V k = shifted - C::shifter;
+        quadrant = (M) shifted - (M) splat<V>(C::shifter);
+        const Pair<V> a = two_sum(x - k * P::pio2_1, -(k * P::pio2_2));
+        const Pair<V> b = two_sum(a.hi, -(k * P::pio2_3));
+        return fast_two_sum(b.hi, (a.lo + b.lo) - k * P::pio2_3t);
+    }
+
+    /* sin and cos as pairs: fdlibm's __kernel_sin and __kernel_cos on the reduced pair with their leading terms
+     * kept apart, the quadrant choosing and negating as in sincos_kernel. Lanes past trig_bound are the caller's. */
+    template <typename V>
+    void sincos_pair(const V& x, Pair<V>& sin_x, Pair<V>& cos_x) {
+        using P = PreciseConstants;
+        using M = vector_mask<V>;
+        M quadrant;
+        const Pair<V> y = reduce_pio2_pair(x, quadrant);
+        const Pair<V> square = two_product(y.hi, y.hi);
+        const V z = square.hi;
+        const V v = madd(square.lo, y.hi, z * y.hi);
+        const V s = horner(z, P::sin_coefficients);
+        const Pair<V> sin_y = fast_two_sum(y.hi, v * P::sin_s1 - (z * (0.5 * y.lo - v * s) - y.lo));
+        const V hz = 0.5 * z;
+        const V w = 1 - hz;
+        const V c = z * z * horner(z, P::cos_coefficients);
+        const Pair<V> cos_y = fast_two_sum(w, ((1 - w) - hz) + (c - madd(y.hi, y.lo, 0.5 * square.lo)));
+
+        const M sign = (M) splat<V>(-0.0);
+        const M odd = (quadrant & 1) != 0;
+        const auto choose = [&](const Pair<V>& a, const Pair<V>& b, const M& negate) {
+            return Pair<V>{(V) ((M) blend(odd, a.hi, b.hi) ^ negate), (V) ((M) blend(odd, a.lo, b.lo) ^ negate)};
+        };
+        sin_x = choose(cos_y, sin_y, ((quadrant & 2) != 0) & sign);
+        cos_x = choose(sin_y, cos_y, (((quadrant + 1) & 2) != 0) & sign);
+    }
+
+    /* result, with f(x) from the C library in the lanes past trig_bound */
+    template <typename V, typename F>
+    [[nodiscard]] V trig_far(const V& x, V result, F f) {
+        const auto far = abs_lanes(x) > KernelConstants<double>::trig_bound;
+        for (size_t i = 0; i < sizeof(V) / sizeof(double); ++i) {
+            if (far[i]) {
+                result[i] = f(x[i]);
+            }
+        }
+        return result;
+    }
+
+    /* A zero keeps its sign through sin and tan, which the pairs' sums do not */
+    template <typename V>
+    [[nodiscard]] V sin_precise(const V& x) {
+        Pair<V> sin_x, cos_x;
+        sincos_pair(x, sin_x, cos_x);
+        return trig_far(x, blend(x == 0, x, sin_x.hi + sin_x.lo), [](double y) { return std::sin(y); });
+    }
+
+    template <typename V>
+    [[nodiscard]] V cos_precise(const V& x) {
+        Pair<V> sin_x, cos_x;
+        sincos_pair(x, sin_x, cos_x);
+        return trig_far(x, cos_x.hi + cos_x.lo, [](double y) { return std::cos(y); });
+    }
+
+    template <typename V>
+    [[nodiscard]] V tan_precise(const V& x) {
+        Pair<V> sin_x, cos_x;
+        sincos_pair(x, sin_x, cos_x);
+        const Pair<V> q = sin_x / cos_x;
+        return trig_far(x, blend(x == 0, x, q.hi + q.lo), [](double y) { return std::tan(y); });
+    }
+
+    /* fdlibm's atan: |x| in [7/16, 11/16), [11/16, 19/16) or [19/16, 39/16) is moved by atan(c) for c = 1/2, 1 or
+     * 3/2 through u = (|x| - c) / (1 + c|x|), whose numerator is exact, and |x| >= 39/16 reflects through u = -1/|x|
+     * about atan(inf); then |u| < 7/16 */
+    template <typename V>
+    [[nodiscard]] V atan_precise(const V& x) {
+        using P = PreciseConstants;
+        const V a = abs_lanes(x);
+        const auto reflected = a >= 39.0 / 16;
+        const auto past_3_2 = a >= 19.0 / 16;
+        const auto past_1 = a >= 11.0 / 16;
+        const auto past_1_2 = a >= 7.0 / 16;
+        /* The entry for each interval, zero below 7/16 */
+        const auto pick = [&](const double (&entries)[4]) {
+            V v = blend(past_1_2, splat<V>(entries[0]), V{});
+            v = blend(past_1, splat<V>(entries[1]), v);
+            v = blend(past_3_2, splat<V>(entries[2]), v);
+            return blend(reflected, splat<V>(entries[3]), v);
+        };
+        constexpr double shifts[] = {0.5, 1, 1.5, 0};
+        const V c = pick(shifts);
+        const V hi = pick(P::atan_hi);
+        const V lo = pick(P::atan_lo);
+        const V u = blend(reflected, -1 / a, (a - c) / madd(c, a, splat<V>(1)));
+        const V z = u * u;
+        return copysign_lanes(hi - ((u * z * horner(z, P::atan_coefficients) - lo) - u), x);
+    }
+
+    /* s with the low 32 bits of its representation cleared, so that it squares exactly */
+    template <typename V>
+    [[nodiscard]] V high_word(const V& s) {
+        using M = vector_mask<V>;
+        return (V) ((M) s & (M{} - (int64_t{1} << 32)));
+    }
+
+    /* fdlibm's asin: |x| + |x| R(x^2) below 1/2, R a rational function, and pi/2 - 2 asin(sqrt(t)), t = (1 - |x|) / 2,
+     * above; up to 0.975 the root s = w + c is split so that pi/4 - 2w is exact */
+    template <typename V>
+    [[nodiscard]] V asin_precise(const V& x) {
+        using P = PreciseConstants;
+        const V a = abs_lanes(x);
+        const auto small = a < 0.5;
+        const V t = blend(small, a * a, 0.5 * (1 - a));
+        const V r = t * horner(t, P::asin_p) / horner(t, P::asin_q);
+        const V s = sqrt_lanes(t);
+        const V near_one = P::pio2_hi - (2 * (s + s * r) - P::pio2_lo);
+        const V w = high_word(s);
+        const V c = (t - w * w) / (s + w);
+        const V middle = P::pio4_hi - ((2 * s * r - (P::pio2_lo - 2 * c)) - (P::pio4_hi - 2 * w));
+        return copysign_lanes(blend(small, a + a * r, blend(a > 0.975, near_one, middle)), x);
+    }
+
+    /* fdlibm's acos: pi/2 - (x + x R(x^2)) below 1/2 in magnitude; above, 2 asin(sqrt(z)) with z = (1 - |x|) / 2
+     * for positive x, its root split as in asin_precise, and pi less that for negative x */
+    template <typename V>
+    [[nodiscard]] V acos_precise(const V& x) {
+        using P = PreciseConstants;
+        const V a = abs_lanes(x);
+        const auto small = a < 0.5;
+        const V z = blend(small, x * x, 0.5 * (1 - a));
+        const V r = z * horner(z, P::asin_p) / horner(z, P::asin_q);
+        const V s = sqrt_lanes(z);
+        const V w = high_word(s);
+        const V c = (z - w * w) / (s + w);
+        const V positive = 2 * (w + (r * s + c));
+        const V negative = P::pi - 2 * (s + (r * s - P::pio2_lo));
+        const V result = blend(small, P::pio2_hi - (x - (P::pio2_lo - x * r)), blend(x < 0, negative, positive));
+        return blend(x == 1, V{}, result);
+    }
+
+
+    /* Runs a kernel at the requested tier: fast as is, precise through the double kernel for float and through the
+     * precise double kernel for double */
+    template <Accuracy A, floating T, size_t N, typename Kernel, typename Precise>
+    [[nodiscard]] Packet<T, N> transcendental(const Packet<T, N>& x, Kernel kernel, Precise precise) {
+        if constexpr (A == Accuracy::fast) {
+            return {kernel(x.v)};
+        } else if constexpr (std::is_same_v<T, float>) {
+            return {in_double(kernel, x.v)};
+        } else {
+            return {precise(x.v)};
+        }
+    }
+} // namespace detail
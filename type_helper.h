@@ -3,6 +3,9 @@
 
 #include <cstdint>
 #include <concepts>
+#include <string_view>
+
+#include "half.h"
 
 
 namespace detail {
@@ -22,14 +25,41 @@ namespace detail {
     concept floating = is_any_of_v<std::remove_cv_t<T>, float, double>;
 
     template <typename T>
-    concept numeric = integral<T> || floating<T>;
+    concept half_floating = is_any_of_v<std::remove_cv_t<T>, float16, bfloat16>;
+
+    template <typename T>
+    concept numeric = integral<T> || floating<T> || half_floating<T>;
 
     template <numeric T>
     using to_floating = std::conditional_t<floating<T>, std::remove_cv_t<T>, float>;
 
+    /* The type arithmetic on T runs in: 16-bit floats are widened to float, everything else is itself */
+    template <numeric T>
+    using compute_type = std::conditional_t<half_floating<T>, float, std::remove_cv_t<T>>;
+
+    /* Name of an element type as printed by explain() and the profiler */
+    template <numeric T>
+    [[nodiscard]] constexpr std::string_view type_name() {
+        using U = std::remove_cv_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            return "bool";
+        } else if constexpr (floating<U>) {
+            return sizeof(U) == 4 ? "float32" : "float64";
+        } else if constexpr (half_floating<U>) {
+            return std::is_same_v<U, float16> ? "float16" : "bfloat16";
+        } else if constexpr (signed_integral<U>) {
+            return sizeof(U) == 1 ? "int8" : sizeof(U) == 2 ? "int16" : sizeof(U) == 4 ? "int32" : "int64";
+        } else {
+            return sizeof(U) == 1 ? "uint8" : sizeof(U) == 2 ? "uint16" : sizeof(U) == 4 ? "uint32" : "uint64";
+        }
+    }
+
     template <numeric L, numeric R>
     constexpr auto common_type_impl() noexcept {
-        if constexpr (std::is_same_v<L, R>) {
+        if constexpr (half_floating<L> || half_floating<R>) {
+            /* Only loads and stores are 16 bits wide; results are float, or the other operand's type if wider */
+            return common_type_impl<compute_type<L>, compute_type<R>>();
+        } else if constexpr (std::is_same_v<L, R>) {
             return L{};
         } else {
             if constexpr (floating<L> || floating<R>) {
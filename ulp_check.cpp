@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "tensor.h"
+
+
+/* Error of every transcendental op, in both accuracy tiers and for float and double, against the long double
+ * functions of the C library. Each op is swept over its domain twice, once evenly in the bit patterns, which visits
+ * every binade including the subnormals, and once uniformly at random, then checked at its special arguments:
+ * zeros, infinities, NaN, the smallest and largest values and the edges of the domain.
+ *
+ * Output is CSV on stdout, one row per op, type and tier:
+ *     op,type,accuracy,points,max_ulp,at
+ * Exits with 1 if the precise tier is ever more than 1 ulp away or the fast tier more than 4, or if a special
+ * argument gives a NaN, an infinity or a sign of zero other than the C library's.
+ *
+ * Usage: ulp_check [--filter SUBSTRING] [--points N]
+ * Build with the flags the library will ship with; the kernels differ with the SIMD width and hardware FMA. */
+
+
+namespace {
+    struct Options {
+        std::string_view filter;
+        size_t points = size_t{1} << 20;
+    };
+
+    template <typename T>
+    constexpr std::string_view type_name() {
+        return std::is_same_v<T, float> ? "float32" : "float64";
+    }
+
+    constexpr std::string_view tier_name(Accuracy a) {
+        return a == Accuracy::precise ? "precise" : "fast";
+    }
+
+    constexpr double ulp_bound(Accuracy a) {
+        return a == Accuracy::precise ? 1.0 : 4.0;
+    }
+
+    /* Distance from result to reference in units of the last place of T at the reference. An infinite result is
+     * exact where the reference rounds to it and counts as the next power of two past the largest value elsewhere; a
+     * NaN, an infinity or a zero of the wrong sign is infinitely far from the reference. */
+    template <typename T>
+    double ulp_error(T result, long double reference) {
+        constexpr double never = std::numeric_limits<double>::infinity();
+        if (std::isnan(reference) || std::isnan(result)) {
+            return std::isnan(reference) && std::isnan(result) ? 0 : never;
+        }
+        if (std::isinf(reference)) {
+            return result == reference ? 0 : never;
+        }
+        if (reference == 0 && result == 0) {
+            return std::signbit(reference) == std::signbit(result) ? 0 : never;
+        }
+        if (std::isinf(result) && static_cast<T>(reference) == result) {
+            return 0;
+        }
+        using limits = std::numeric_limits<T>;
+        const int exponent = std::clamp(std::ilogb(reference), limits::min_exponent - 1, limits::max_exponent - 1);
+        const long double ulp = std::ldexp(1.0L, exponent - limits::digits + 1);
+        const long double value = std::isinf(result) ? std::copysign(std::ldexp(1.0L, limits::max_exponent), result)
+                                                     : static_cast<long double>(result);
+        return static_cast<double>(std::fabs(value - reference) / ulp);
+    }
+
+    /* Bit patterns in the same order as the values they encode */
+    template <typename T>
+    auto ordered(T x) {
+        using U = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+        const auto bits = std::bit_cast<U>(x);
+        return bits < 0 ? std::numeric_limits<U>::min() - bits : bits;
+    }
+
+    template <typename T>
+    T from_ordered(decltype(ordered(T{})) k) {
+        using U = decltype(k);
+        return std::bit_cast<T>(k < 0 ? static_cast<U>(std::numeric_limits<U>::min() - k) : k);
+    }
+
+    /* Arguments in [lo, hi]: evenly spaced patterns, uniform values, then the specials */
+    template <typename T>
+    std::vector<T> arguments(const Options& options, T lo, T hi) {
+        std::vector<T> x;
+        const auto first = ordered(lo);
+        const auto span = static_cast<double>(ordered(hi)) - static_cast<double>(first);
+        for (size_t i = 0; i < options.points; ++i) {
+            const double step = span * static_cast<double>(i) / static_cast<double>(options.points - 1);
+            x.push_back(from_ordered<T>(first + static_cast<decltype(first)>(step)));
+        }
+        std::mt19937_64 rng(options.points);
+        std::uniform_real_distribution<T> uniform(std::max(lo, std::numeric_limits<T>::lowest() / 2),
+                                                  std::min(hi, std::numeric_limits<T>::max() / 2));
+        for (size_t i = 0; i < options.points; ++i) {
+            x.push_back(uniform(rng));
+        }
+        using limits = std::numeric_limits<T>;
+        for (const T s : {T(0), limits::infinity(), limits::quiet_NaN(), limits::denorm_min(), limits::min(),
+                          limits::max(), T(0.5), T(1), T(2), T(1) + limits::epsilon(), T(1) - limits::epsilon() / 2,
+                          T(1e6), T(1e22)}) {
+            x.push_back(s);
+            x.push_back(-s);
+        }
+        return x;
+    }
+
+    /* Checks one op at both tiers: expr maps a tensor to the op's expression at the tier given as its template
+     * argument, and reference is the op in long double */
+    template <typename T>
+    bool check(const Options& options, std::string_view op, T lo, T hi, auto expr, auto reference) {
+        if (op.find(options.filter) == std::string_view::npos) {
+            return true;
+        }
+        std::vector<T> x = arguments(options, lo, hi);
+        const Tensor<T> in(x.data(), x.size());
+        bool passed = true;
+        for (const Accuracy a : {Accuracy::precise, Accuracy::fast}) {
+            const Tensor<T> out = a == Accuracy::precise ? Tensor<T>(expr.template operator()<Accuracy::precise>(in))
+                                                         : Tensor<T>(expr.template operator()<Accuracy::fast>(in));
+            double worst = 0;
+            T at = 0;
+            for (size_t i = 0; i < x.size(); ++i) {
+                const double error = ulp_error(out[i], reference(static_cast<long double>(x[i])));
+                if (!(error <= worst)) {
+                    worst = error;
+                    at = x[i];
+                }
+            }
+            passed &= worst <= ulp_bound(a);
+            std::printf("%.*s,%.*s,%.*s,%zu,%.3f,%.17g\n", int(op.size()), op.data(), int(type_name<T>().size()),
+                        type_name<T>().data(), int(tier_name(a).size()), tier_name(a).data(), x.size(), worst,
+                        static_cast<double>(at));
+        }
+        return passed;
+    }
+
+    template <typename T>
+    bool run(const Options& o) {
+        constexpr T max = std::numeric_limits<T>::max();
+        constexpr T inf = std::numeric_limits<T>::infinity();
+        /* From where e^x is zero in T to where it overflows */
+        constexpr T exp_lo = std::is_same_v<T, float> ? T(-110) : T(-750);
+        constexpr T exp_hi = std::is_same_v<T, float> ? T(90) : T(720);
+        bool passed = true;
+        passed &= check<T>(o, "exp", exp_lo, exp_hi, []<Accuracy A>(const auto& x) { return x.template exp<A>(); },
+                           [](long double x) { return std::exp(x); });
+        passed &= check<T>(o, "log", 0, inf, []<Accuracy A>(const auto& x) { return x.template log<A>(); },
+                           [](long double x) { return std::log(x); });
+        passed &= check<T>(o, "log10", 0, inf, []<Accuracy A>(const auto& x) { return x.template log10<A>(); },
+                           [](long double x) { return std::log10(x); });
+        passed &= check<T>(o, "sin", -T(1e6), T(1e6), []<Accuracy A>(const auto& x) { return x.template sin<A>(); },
+                           [](long double x) { return std::sin(x); });
+        passed &= check<T>(o, "cos", -T(1e6), T(1e6), []<Accuracy A>(const auto& x) { return x.template cos<A>(); },
+                           [](long double x) { return std::cos(x); });
+        passed &= check<T>(o, "tan", -T(1e6), T(1e6), []<Accuracy A>(const auto& x) { return x.template tan<A>(); },
+                           [](long double x) { return std::tan(x); });
+        passed &= check<T>(o, "asin", -1, 1, []<Accuracy A>(const auto& x) { return x.template asin<A>(); },
+                           [](long double x) { return std::asin(x); });
+        passed &= check<T>(o, "acos", -1, 1, []<Accuracy A>(const auto& x) { return x.template acos<A>(); },
+                           [](long double x) { return std::acos(x); });
+        passed &= check<T>(o, "atan", -max, max, []<Accuracy A>(const auto& x) { return x.template atan<A>(); },
+                           [](long double x) { return std::atan(x); });
+        passed &= check<T>(o, "sinh", -exp_hi, exp_hi, []<Accuracy A>(const auto& x) { return x.template sinh<A>(); },
+                           [](long double x) { return std::sinh(x); });
+        passed &= check<T>(o, "cosh", -exp_hi, exp_hi, []<Accuracy A>(const auto& x) { return x.template cosh<A>(); },
+                           [](long double x) { return std::cosh(x); });
+        passed &= check<T>(o, "tanh", -max, max, []<Accuracy A>(const auto& x) { return x.template tanh<A>(); },
+                           [](long double x) { return std::tanh(x); });
+        passed &= check<T>(o, "asinh", -max, max, []<Accuracy A>(const auto& x) { return x.template asinh<A>(); },
+                           [](long double x) { return std::asinh(x); });
+        passed &= check<T>(o, "acosh", 1, max, []<Accuracy A>(const auto& x) { return x.template acosh<A>(); },
+                           [](long double x) { return std::acosh(x); });
+        passed &= check<T>(o, "atanh", -1, 1, []<Accuracy A>(const auto& x) { return x.template atanh<A>(); },
+                           [](long double x) { return std::atanh(x); });
+        return passed;
+    }
+
+    [[noreturn]] void usage() {
+        std::fprintf(stderr, "usage: ulp_check [--filter SUBSTRING] [--points N]\n");
+        std::exit(2);
+    }
+
+    Options parse(int argc, char** argv) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view flag = argv[i];
+            if (i + 1 >= argc) {
+                usage();
+            }
+            const char* value = argv[++i];
+            if (flag == "--filter") {
+                options.filter = value;
+            } else if (flag == "--points") {
+                options.points = std::strtoull(value, nullptr, 10);
+                if (options.points < 2) {
+                    usage();
+                }
+            } else {
+                usage();
+            }
+        }
+        return options;
+    }
+} // namespace
+
+
+int main(int argc, char** argv) {
+    const Options options = parse(argc, argv);
+    std::printf("op,type,accuracy,points,max_ulp,at\n");
+    const bool passed = run<float>(options) & run<double>(options);
+    return passed ? 0 : 1;
+}